@@ -0,0 +1,127 @@
+#ifndef ACCESS_MAP_H
+#define ACCESS_MAP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "debugger.h"
+#include "emulator.h"
+#include "instruction_set.h"
+#include "symbol_map.h"
+
+// Memory access heatmap for Intel8080::execute(cycle_limit, monitor). Counts
+// data reads and writes per byte accessed and instructions executed per
+// opcode address, per 256-byte page and, if asked for, per byte. It also
+// remembers which bytes have been executed, so a write to one of them is
+// recorded as self-modifying code along with the instruction that made it,
+// and running the patched byte again is counted. Data accesses come from a
+// per-opcode table of where the operand is (BC, DE, HL, the stack or a
+// direct address), built from Debugger::accesses, so the stack writes of
+// interrupts are not seen.
+class AccessMap {
+  public:
+    struct Counts {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t executes = 0;
+    };
+
+    // Writes to a byte that had already been executed
+    struct CodeWrite {
+        // PC of the first instruction that wrote it
+        uint16_t writer;
+        uint64_t writes = 0;
+        // Times it was executed again after being written
+        uint64_t runs = 0;
+    };
+
+    explicit AccessMap(bool per_byte = false);
+
+    void before(Intel8080 &cpu) {
+        const Operand &operand = operands[cpu.memory[cpu.PC]];
+        if (operand.width == 0 || (cpu.PSW & operand.flag) != operand.when) {
+            return;
+        }
+        uint16_t direct = cpu.memory[static_cast<uint16_t>(cpu.PC + 1)] |
+                          cpu.memory[static_cast<uint16_t>(cpu.PC + 2)] << 8;
+        const uint16_t bases[] = {cpu.BC, cpu.DE, cpu.HL, cpu.SP,
+                                  static_cast<uint16_t>(cpu.SP - 2), direct};
+        uint16_t address = bases[operand.base];
+        for (uint8_t i = 0; i < operand.width; i++, address++) {
+            if (operand.access & Debugger::Read) {
+                add(&Counts::reads, address);
+            }
+            if (operand.access & Debugger::Write) {
+                add(&Counts::writes, address);
+                if (state[address] & Executed) {
+                    codeWrite(cpu.PC, address);
+                }
+            }
+        }
+    }
+
+    void step(const Intel8080 &, uint16_t pc, uint8_t inst, size_t) {
+        add(&Counts::executes, pc);
+        if (!(state[pc] & Opcode)) {
+            markExecuted(pc, OPCODES[inst].length);
+        }
+    }
+
+    const std::array<Counts, 0x100> &pages() const { return page_counts; }
+    // Empty unless counting per byte
+    const std::vector<Counts> &bytes() const { return byte_counts; }
+    const std::map<uint16_t, CodeWrite> &codeWrites() const { return writes; }
+
+    // The busiest pages and every write to executed code
+    void report(std::ostream &os, size_t top = 20,
+                const SymbolMap *symbols = nullptr) const;
+    // CSV of every page, or every byte, that was accessed:
+    // `address,reads,writes,executes` with hex addresses. Throws
+    // std::runtime_error if the file cannot be written.
+    void writeHeatmap(const std::filesystem::path &path) const;
+
+  private:
+    // Executed covers operand bytes. Opcode marks where an instruction ran
+    // from, until a byte it could cover is written.
+    enum State : uint8_t { Executed = 1, Opcode = 2, Written = 4 };
+
+    // Where an opcode's data access goes
+    enum Base : uint8_t { BC, DE, HL, SP, Push, Direct };
+    struct Operand {
+        Base base;
+        uint8_t access;
+        // Bytes accessed, 0 for none
+        uint8_t width;
+        // Conditional calls and returns touch the stack only when the flag
+        // bit in PSW is `when`; zero for everything else
+        uint8_t flag;
+        uint8_t when;
+    };
+    using Operands = std::array<Operand, 0x100>;
+
+    const Operands &operands;
+
+    std::array<Counts, 0x100> page_counts{};
+    std::vector<Counts> byte_counts;
+    std::array<uint8_t, 0x10000> state{};
+    std::map<uint16_t, CodeWrite> writes;
+
+    void add(uint64_t Counts::*field, uint16_t address) {
+        page_counts[address >> 8].*field += 1;
+        if (!byte_counts.empty()) {
+            byte_counts[address].*field += 1;
+        }
+    }
+
+    // Probes Debugger::accesses once for every opcode
+    static const Operands &probeOperands();
+    void codeWrite(uint16_t pc, uint16_t address);
+    void markExecuted(uint16_t pc, size_t length);
+};
+
+#endif
@@ -1,43 +1,99 @@
 #ifndef ASSEMBLER_H
 #define ASSEMBLER_H
 
-#include <istream>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-class Intel8080Assembler {
-  private:
-    std::istream &is;
-    uint8_t *memory;
-
-    std::string line;
-    size_t line_number;
+#include "assembly_syntax.h"
+#include "object.h"
 
-    std::unordered_map<std::string, uint16_t> label2addr;
-    std::unordered_map<std::string, uint16_t> addr2fix;
+// Assembles 8080 source held in memory, typically a memory-mapped file. The
+// lexer hands out string_views into the source, so labels and fixups refer
+// to it directly and `source` must outlive the assembler. Errors are
+// collected rather than thrown; assembly carries on with the next line.
+class Intel8080Assembler {
+  public:
+    struct Error {
+        size_t line;
+        std::string message;
+    };
 
-    bool had_errors = false;
+    // A source line and the bytes it assembled to, for listings and symbol
+    // maps
+    struct Line {
+        size_t number;
+        uint16_t offset;
+        uint8_t size;
+        std::string_view text;
+    };
 
-  public:
-    Intel8080Assembler(std::istream &istream) : is(istream), line_number(0) {}
+    // `first_line` numbers the first line of `source` in error messages
+    explicit Intel8080Assembler(std::string_view source, size_t first_line = 1)
+        : source(source), line_number(first_line - 1) {}
 
+    // A flat binary at address 0; every label must be defined
     std::vector<uint8_t> assemble();
-    bool hadErrors() { return had_errors; }
+    // A relocatable object. Labels starting with '@' are local to it and
+    // must be defined in it, unless `export_local` is set for pieces of one
+    // source that are linked back to back; every other label is exported.
+    // Labels that are not defined are left for the linker.
+    Object assembleObject(bool export_local = false);
+    bool hadErrors() const { return !reported.empty(); }
+    const std::vector<Error> &errors() const { return reported; }
+
+    // Records every line assembled from now on in lines()
+    void keepLines() { keep_lines = true; }
+    const std::vector<Line> &lines() const { return kept; }
+    // Every label defined so far and its offset, by offset
+    std::vector<std::pair<std::string_view, uint16_t>> labels() const;
 
   private:
-    void assembleLine(std::vector<uint8_t> &program);
-    void fixBranches(std::vector<uint8_t> &program);
+    // Labels are case-insensitive
+    struct FoldedHash {
+        size_t operator()(std::string_view token) const;
+    };
+    struct FoldedEqual {
+        bool operator()(std::string_view a, std::string_view b) const {
+            return syntax::equalFolded(a, b);
+        }
+    };
+
+    // A word to patch once all labels are known
+    struct Fixup {
+        std::string_view label;
+        uint16_t location;
+        size_t line;
+    };
+
+    std::string_view source;
+    size_t line_number;
+    // The tokens of the current line
+    syntax::SourceLine line;
 
-    std::vector<std::string> parseLine();
+    std::unordered_map<std::string_view, uint16_t, FoldedHash, FoldedEqual>
+        label2addr;
+    std::vector<Fixup> addr2fix;
+
+    std::vector<Error> reported;
+    bool keep_lines = false;
+    std::vector<Line> kept;
+
+    void assembleLines(std::vector<uint8_t> &program);
+    bool assembleLine(std::vector<uint8_t> &program);
+    void fixBranches(std::vector<uint8_t> &program);
 
-    std::optional<uint16_t> parseAddress(std::string token);
-    uint8_t parseImmediate(std::string token);
-    uint8_t parseRegister(std::string token);
-    uint8_t parseRegisterPair(std::string token);
+    // A number with an optional H, O, Q, B or D radix suffix, or a
+    // character literal, up to `max`
+    std::optional<uint16_t> parseNumber(std::string_view token, uint16_t max);
 
-    template <typename... Ts> void error(Ts... args);
+    // Records an error for the current line and returns false
+    template <typename... Ts> bool error(const Ts &...args);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,52 @@
+#ifndef ASSEMBLY_CACHE_H
+#define ASSEMBLY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Incremental assembly of one source. The source is split into chunks of
+// lines at content-defined boundaries, so an edit only changes the chunks it
+// touches. Each chunk is assembled as a relocatable object and the objects
+// are linked back to back, which redoes the layout and every fixup in one
+// linear pass. Chunk objects are kept in a cache file keyed by a hash of the
+// chunk's text; only chunks missing from it are reassembled.
+class AssemblyCache {
+  public:
+    // Loads the cache file if there is one. A file that cannot be read is
+    // treated as an empty cache.
+    explicit AssemblyCache(std::filesystem::path path);
+
+    // A flat binary at address 0, the same as Intel8080Assembler::assemble()
+    // gives. `name` prefixes error messages, which are appended to `errors`.
+    std::vector<uint8_t> assemble(std::string_view source,
+                                  const std::string &name,
+                                  std::vector<std::string> &errors);
+
+    // Writes back the chunks used by the last assemble(), if anything
+    // changed. Throws std::runtime_error if the file cannot be written.
+    void save();
+
+    size_t hits() const { return hit; }
+    size_t misses() const { return missed; }
+
+  private:
+    struct Entry {
+        Object object;
+        bool used = false;
+    };
+
+    std::filesystem::path path;
+    std::unordered_map<uint64_t, Entry> entries;
+    size_t hit = 0;
+    size_t missed = 0;
+    bool dirty = false;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef ASSEMBLY_SYNTAX_H
+#define ASSEMBLY_SYNTAX_H
+
+#include <cstddef>
+#include <string_view>
+
+// The line syntax shared by the assembler and the compile-time assembler:
+//
+//   [LABEL:] [MNEMONIC [OPERAND [, OPERAND]]] [; comment]
+//
+// Everything here is constexpr and works on string_views into the source.
+namespace syntax {
+
+constexpr bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+constexpr bool isDigit(char c) { return '0' <= c && c <= '9'; }
+
+// Lowercase for ASCII letters; mnemonics, registers and labels ignore case
+constexpr char fold(char c) { return 'A' <= c && c <= 'Z' ? c | 0x20 : c; }
+
+constexpr bool equalFolded(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (fold(a[i]) != fold(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct SourceLine {
+    std::string_view label;
+    std::string_view mnemonic;
+    std::string_view operands[2];
+    size_t operand_count;
+};
+
+// Splits one line without its newline into `line`. On a syntax error calls
+// error(message, token) and returns false.
+template <typename Error>
+constexpr bool lexLine(std::string_view text, SourceLine &line,
+                       Error &&error) {
+    line = {};
+    size_t i = 0;
+    auto skipSpace = [&] {
+        while (i < text.size() && isSpace(text[i])) {
+            i++;
+        }
+    };
+    auto atEnd = [&] { return i == text.size() || text[i] == ';'; };
+    auto word = [&] {
+        size_t start = i;
+        if (i < text.size() && text[i] == '\'') {
+            // Character literal, which may hold a space, comma or semicolon
+            i = i + 3 < text.size() ? i + 3 : text.size();
+        }
+        while (i < text.size() && !isSpace(text[i]) && text[i] != ',' &&
+               text[i] != ';') {
+            i++;
+        }
+        return text.substr(start, i - start);
+    };
+
+    skipSpace();
+    if (atEnd()) {
+        return true;
+    }
+    auto first = word();
+    if (first.empty()) {
+        error("expected label or mnemonic", first);
+        return false;
+    }
+    if (first.back() == ':') {
+        line.label = first.substr(0, first.size() - 1);
+        if (line.label.empty()) {
+            error("empty label", first);
+            return false;
+        }
+        skipSpace();
+        if (atEnd()) {
+            return true;
+        }
+        first = word();
+    }
+    line.mnemonic = first;
+
+    skipSpace();
+    while (!atEnd()) {
+        if (line.operand_count == 2) {
+            error("unexpected token after operands", word());
+            return false;
+        }
+        auto operand = word();
+        if (operand.empty()) {
+            error("expected operand", operand);
+            return false;
+        }
+        line.operands[line.operand_count++] = operand;
+        skipSpace();
+        if (i < text.size() && text[i] == ',') {
+            i++;
+            skipSpace();
+            if (atEnd()) {
+                error("expected operand after ','", "");
+                return false;
+            }
+        } else if (!atEnd()) {
+            error("expected comment or end of line", "");
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace syntax
+
+#endif
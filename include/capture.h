@@ -0,0 +1,84 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records Space Invaders frames to a file. add() only copies the frame's
+// VRAM into the front buffer; when that fills it is swapped with the back
+// buffer, which a writer thread expands to the output format and writes
+// out in one go. Both buffers are allocated up front. add() waits only if
+// the writer is still busy with the previous buffer when the next one is
+// full. Throws std::runtime_error if the file cannot be opened or written;
+// once a write has failed, add() throws without buffering anything.
+class Capture {
+  public:
+    enum class Format {
+        // Each frame's VRAM as is, 7168 bytes
+        Packed,
+        // Upright 224x256 image, one byte per pixel
+        Gray,
+        // Upright 224x256 monochrome YUV4MPEG2 stream
+        Y4M,
+    };
+
+    static constexpr size_t WIDTH = 224;
+    static constexpr size_t HEIGHT = 256;
+    static constexpr size_t VRAM_SIZE = WIDTH * HEIGHT / 8;
+
+    Capture(const std::filesystem::path &path, Format format,
+            unsigned fps = 60, size_t frames_per_buffer = 64);
+    ~Capture();
+    Capture(const Capture &) = delete;
+    Capture &operator=(const Capture &) = delete;
+
+    // Picks the format from the extension: .y4m, .gray or anything else
+    // for packed VRAM.
+    static Format formatFor(const std::filesystem::path &path);
+
+    void add(const uint8_t *vram);
+    // Writes out everything added so far and closes the file. Later calls do
+    // nothing.
+    void close();
+
+    uint64_t frames() const { return added; }
+    // Times add() had to wait for the writer
+    uint64_t stalls() const { return waited; }
+
+  private:
+    struct Buffer {
+        std::vector<uint8_t> vram;
+        size_t count = 0;
+    };
+
+    std::ofstream os;
+    Format format;
+    size_t capacity;
+    Buffer front;
+    Buffer back;
+    std::vector<uint8_t> expanded;
+    uint64_t added = 0;
+    uint64_t waited = 0;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool busy = false;
+    bool quit = false;
+    std::string error;
+    // Set by swap() when it reports the error, read only by this thread
+    bool failed = false;
+    std::thread writer;
+
+    void swap();
+    void write();
+    void expand(const uint8_t *vram, uint8_t *out) const;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Guest console output. Characters are collected in a per-instance buffer and
+// handed to the sink in large writes, so a guest printing one character at a
+// time costs a buffer append rather than a stream call.
+//
+// Batch consoles flush when the buffer fills, interactive consoles also flush
+// at every newline, and capturing consoles never write to the sink and keep
+// the whole transcript for the caller to inspect.
+class Console {
+  public:
+    enum class Mode { Batch, Interactive, Capture };
+
+    explicit Console(Mode mode = Mode::Batch, std::ostream &sink = std::cout)
+        : sink(&sink) {
+        buffer.reserve(BUFFER_SIZE);
+        setMode(mode);
+    }
+    Console(const Console &) = delete;
+    Console &operator=(const Console &) = delete;
+    ~Console() { flush(); }
+
+    void put(uint8_t c) {
+        buffer.push_back(c);
+        if (buffer.size() >= limit ||
+            (c == '\n' && mode == Mode::Interactive)) {
+            flush();
+        }
+    }
+
+    void write(const uint8_t *data, size_t length);
+    void flush();
+
+    void setMode(Mode mode);
+    void setSink(std::ostream &sink);
+
+    // The transcript so far, only complete in capture mode.
+    const std::string &captured() const { return buffer; }
+    void clear() { buffer.clear(); }
+
+  private:
+    static constexpr size_t BUFFER_SIZE = 0x10000;
+
+    Mode mode = Mode::Batch;
+    size_t limit = BUFFER_SIZE;
+    std::ostream *sink;
+    std::string buffer;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef CONSTEXPR_ASSEMBLER_H
+#define CONSTEXPR_ASSEMBLER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "assembly_syntax.h"
+#include "instruction_set.h"
+
+// Assembles 8080 source at compile time into a std::array<uint8_t, N>:
+//
+//   constexpr auto stub = assemble8080<R"(
+//           OUT 0FFH
+//           RET
+//   )">();
+//
+// Labels resolve against the origin given as the second template argument.
+// The syntax and encoding are the assembler's. An error in the source fails
+// the build, and the compiler's instantiation note names the line and the
+// problem, e.g. `Diagnostic{3, "invalid opcode 'JPM'"}`.
+class ConstexprAssembler {
+  public:
+    template <size_t N> struct Source {
+        char text[N];
+
+        constexpr Source(const char (&literal)[N]) {
+            for (size_t i = 0; i < N; i++) {
+                text[i] = literal[i];
+            }
+        }
+        constexpr std::string_view view() const { return {text, N - 1}; }
+    };
+
+    struct Diagnostic {
+        size_t line;
+        char message[64];
+    };
+
+    struct Result {
+        size_t size;
+        Diagnostic diagnostic;
+    };
+
+    // Assembles `source` into `out`, or only measures it if `out` is null.
+    // Stops at the first error.
+    static constexpr Result run(std::string_view source, uint16_t origin,
+                                uint8_t *out);
+
+    template <Diagnostic D> static consteval void report() {
+        static_assert(D.line == 0, "error in 8080 source");
+    }
+
+  private:
+    static constexpr size_t MAX_LABELS = 128;
+    static constexpr size_t MAX_FIXUPS = 256;
+
+    // A number with an optional H, O, Q, B or D radix suffix, or a character
+    // literal
+    static constexpr std::optional<uint32_t>
+    parseNumber(std::string_view token);
+};
+
+constexpr std::optional<uint32_t>
+ConstexprAssembler::parseNumber(std::string_view token) {
+    if (token[0] == '\'') {
+        if (token.size() != 3 || token[2] != '\'') {
+            return std::nullopt;
+        }
+        return static_cast<uint8_t>(token[1]);
+    }
+    if (!syntax::isDigit(token[0])) {
+        return std::nullopt;
+    }
+    uint32_t base = 10;
+    size_t length = token.size();
+    switch (syntax::fold(token.back())) {
+    case 'h':
+        base = 16;
+        length--;
+        break;
+    case 'o':
+    case 'q':
+        base = 8;
+        length--;
+        break;
+    case 'b':
+        base = 2;
+        length--;
+        break;
+    case 'd':
+        length--;
+        break;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = syntax::fold(token[i]);
+        uint32_t digit = base;
+        if (syntax::isDigit(c)) {
+            digit = c - '0';
+        } else if ('a' <= c && c <= 'f') {
+            digit = c - 'a' + 10;
+        }
+        if (digit >= base) {
+            return std::nullopt;
+        }
+        // Saturate; anything past 0xffff is out of range anyway
+        value = value * base + digit;
+        if (value > 0x10000) {
+            value = 0x10000;
+        }
+    }
+    return value;
+}
+
+constexpr ConstexprAssembler::Result
+ConstexprAssembler::run(std::string_view source, uint16_t origin,
+                        uint8_t *out) {
+    struct Label {
+        std::string_view name;
+        uint16_t address;
+    };
+    struct Fixup {
+        std::string_view label;
+        size_t location;
+        size_t line;
+    };
+
+    Result result{};
+    Label labels[MAX_LABELS] = {};
+    size_t label_count = 0;
+    Fixup fixups[MAX_FIXUPS] = {};
+    size_t fixup_count = 0;
+    size_t line_number = 0;
+    bool failed = false;
+
+    auto fail = [&](std::string_view message, std::string_view token) {
+        failed = true;
+        auto &diagnostic = result.diagnostic;
+        diagnostic.line = line_number;
+        size_t n = 0;
+        auto append = [&](std::string_view text) {
+            for (size_t i = 0; i < text.size() && n + 1 < 64; i++) {
+                diagnostic.message[n++] = text[i];
+            }
+        };
+        append(message);
+        if (!token.empty()) {
+            append(" '");
+            append(token);
+            append("'");
+        }
+    };
+    auto find = [&](std::string_view name) -> const Label * {
+        for (size_t i = 0; i < label_count; i++) {
+            if (syntax::equalFolded(labels[i].name, name)) {
+                return &labels[i];
+            }
+        }
+        return nullptr;
+    };
+    auto number = [&](std::string_view token,
+                      uint16_t max) -> std::optional<uint16_t> {
+        auto value = parseNumber(token);
+        if (!value) {
+            fail("could not parse number", token);
+            return std::nullopt;
+        }
+        if (*value > max) {
+            fail("value out of range", token);
+            return std::nullopt;
+        }
+        return *value;
+    };
+    auto address = [&](std::string_view token,
+                       size_t offset) -> std::optional<uint16_t> {
+        if (syntax::isDigit(token[0]) || token[0] == '\'') {
+            return number(token, 0xffff);
+        }
+        if (const Label *label = find(token)) {
+            return label->address;
+        }
+        if (fixup_count == MAX_FIXUPS) {
+            fail("too many forward references", "");
+            return std::nullopt;
+        }
+        fixups[fixup_count++] = {token, result.size + offset, line_number};
+        return 0;
+    };
+
+    for (size_t start = 0; start < source.size() && !failed;) {
+        size_t end = source.find('\n', start);
+        if (end == std::string_view::npos) {
+            end = source.size();
+        }
+        line_number++;
+        syntax::SourceLine line;
+        auto text = source.substr(start, end - start);
+        start = end + 1;
+        if (!syntax::lexLine(text, line, fail)) {
+            break;
+        }
+        if (!line.label.empty()) {
+            if (find(line.label) != nullptr) {
+                fail("label already defined", line.label);
+                break;
+            }
+            if (label_count == MAX_LABELS) {
+                fail("too many labels", "");
+                break;
+            }
+            labels[label_count++] = {line.label,
+                                     uint16_t(origin + result.size)};
+        }
+        if (line.mnemonic.empty()) {
+            continue;
+        }
+        auto encoding = encode(line.mnemonic, line.operands,
+                               line.operand_count, number, address, fail);
+        if (!encoding) {
+            break;
+        }
+        if (origin + result.size + encoding->length > 0x10000) {
+            fail("program does not fit below 0x10000", "");
+            break;
+        }
+        for (size_t i = 0; i < encoding->length; i++) {
+            if (out != nullptr) {
+                out[result.size] = encoding->bytes[i];
+            }
+            result.size++;
+        }
+    }
+
+    for (size_t i = 0; i < fixup_count && !failed; i++) {
+        const Label *label = find(fixups[i].label);
+        if (label == nullptr) {
+            line_number = fixups[i].line;
+            fail("could not resolve label", fixups[i].label);
+        } else if (out != nullptr) {
+            out[fixups[i].location] = label->address & 0xff;
+            out[fixups[i].location + 1] = label->address >> 8;
+        }
+    }
+    return result;
+}
+
+template <ConstexprAssembler::Source S, uint16_t ORIGIN = 0>
+consteval auto assemble8080() {
+    constexpr auto measured =
+        ConstexprAssembler::run(S.view(), ORIGIN, nullptr);
+    if constexpr (measured.diagnostic.line != 0) {
+        ConstexprAssembler::report<measured.diagnostic>();
+        return std::array<uint8_t, 0>{};
+    } else {
+        std::array<uint8_t, measured.size> program{};
+        ConstexprAssembler::run(S.view(), ORIGIN, program.data());
+        return program;
+    }
+}
+
+#endif
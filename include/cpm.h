@@ -0,0 +1,60 @@
+#ifndef CPM_H
+#define CPM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "console.h"
+#include "emulator.h"
+
+// A CP/M 2.2 environment for running .COM programs. Page zero and a three
+// byte BDOS entry stub (OUT BDOS_PORT; RET) are installed by load(); the OUT
+// traps into bdos(), which implements the BDOS functions natively. Console
+// output goes through `console`; file functions are backed by host files in
+// `root`.
+struct CPM : Intel8080 {
+    static constexpr uint16_t TPA = 0x0100;
+    static constexpr uint16_t BDOS = 0xfe00;
+    static constexpr uint8_t BDOS_PORT = 0xff;
+
+    std::filesystem::path root = ".";
+    Console console;
+
+    CPM();
+
+    void load(const uint8_t *program, size_t length);
+
+  private:
+    static constexpr uint16_t DEFAULT_DMA = 0x0080;
+
+    uint16_t dma = DEFAULT_DMA;
+    std::unordered_map<std::string, std::fstream> files;
+
+    static void bdosTrap(Intel8080 &cpu, uint8_t port, uint8_t A);
+    void bdos();
+
+    uint16_t consoleInput();
+    void printString(uint16_t address);
+    void readConsoleBuffer(uint16_t address);
+
+    std::string fileName(uint16_t fcb);
+    // The upper-case name in `root`, or the lower-case one if that does
+    // not exist; open, make and delete all go through it
+    std::filesystem::path hostPath(const std::string &name) const;
+    uint16_t openFile(uint16_t fcb, bool create);
+    uint16_t closeFile(uint16_t fcb);
+    uint16_t deleteFile(uint16_t fcb);
+    uint16_t readRecord(uint16_t fcb, uint32_t record);
+    uint16_t writeRecord(uint16_t fcb, uint32_t record);
+    uint16_t fileSize(uint16_t fcb);
+
+    uint32_t sequentialRecord(uint16_t fcb);
+    void advanceSequential(uint16_t fcb);
+    uint32_t randomRecord(uint16_t fcb);
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "emulator.h"
+
+// PC breakpoints and memory watchpoints for an Intel8080. While nothing is
+// armed run() is a plain execute(); otherwise it runs a monitored loop that
+// checks the PC against a bitmap and, only for instructions that touch a
+// watched page, the exact watchpoint ranges. Breakpoints stop before the
+// instruction at their address, watchpoints stop after the instruction that
+// made the access.
+class Debugger {
+  public:
+    enum Access : uint8_t { Read = 1, Write = 2 };
+
+    struct Watchpoint {
+        uint16_t address;
+        uint32_t length;
+        uint8_t access;
+    };
+
+    // A data access made by an instruction
+    struct MemoryAccess {
+        uint16_t address;
+        uint8_t access;
+    };
+
+    explicit Debugger(Intel8080 &cpu) : cpu(cpu) {}
+
+    void addBreakpoint(uint16_t address);
+    bool removeBreakpoint(uint16_t address);
+    std::vector<uint16_t> breakpoints() const;
+
+    // Watches `length` bytes from `address`, clamped to the end of memory
+    void addWatchpoint(uint16_t address, uint32_t length, uint8_t access);
+    bool removeWatchpoint(uint16_t address);
+    const std::vector<Watchpoint> &watchpoints() const { return watches; }
+
+    bool armed() const { return breaks.any() || !watches.empty(); }
+
+    // Runs until a breakpoint, watchpoint or any other stop. A breakpoint at
+    // the current PC is stepped over rather than reported again.
+    Stop run(size_t cycle_limit = 0);
+
+    // Executes a single instruction, still reporting watchpoints
+    Stop step();
+
+    // The access that caused the last Watchpoint stop
+    const MemoryAccess &hit() const { return last_hit; }
+
+    // Data memory accesses the instruction at PC is about to make. Stack
+    // accesses of conditional calls and returns are only reported when the
+    // condition holds.
+    static size_t accesses(const Intel8080 &cpu, MemoryAccess (&out)[2]);
+
+  private:
+    struct Monitor;
+
+    Intel8080 &cpu;
+    std::bitset<0x10000> breaks;
+    std::vector<Watchpoint> watches;
+    std::array<uint8_t, 0x100> pages{};
+    MemoryAccess last_hit{};
+
+    void updatePages();
+    bool watched(MemoryAccess access) const;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "instruction_set.h"
+
+// An instruction as it sits in memory
+struct Instruction {
+    uint16_t address;
+    uint8_t bytes[3];
+
+    const Opcode &opcode() const { return OPCODES[bytes[0]]; }
+    size_t length() const { return opcode().length; }
+    uint16_t word() const { return bytes[1] | bytes[2] << 8; }
+    uint16_t next() const { return address + length(); }
+    // Where a jump, call or restart goes
+    std::optional<uint16_t> target() const;
+};
+
+Instruction decode(const std::array<uint8_t, 0x10000> &memory,
+                   uint16_t address);
+
+// Names for addresses used as jump, call and LXI operands
+using Labels = std::unordered_map<uint16_t, std::string>;
+
+// Assembler syntax that bin/asm accepts, e.g. "MVI A,0FFH" or "JNZ 0040H"
+std::string disassemble(const Instruction &instruction,
+                        const Labels *labels = nullptr);
+
+// The mnemonic and register operands of an opcode, e.g. "MOV A,M" or "LXI H"
+std::string opcodeName(uint8_t opcode);
+
+// Recursive-descent analysis of an image: starting from its entry points,
+// follows fall-through, jumps, calls and restarts to tell code from data and
+// splits the code into basic blocks. Only bytes in [low, high) are traced.
+// Returns and PCHL end a path, as their targets are only known at run time,
+// so code reached only through them (jump tables) stays data.
+class CodeMap {
+  public:
+    struct Block {
+        uint16_t start;
+        uint16_t length;
+        uint16_t instructions;
+        // How the last instruction leaves the block
+        Flow exit;
+        // Statically known next blocks: targets, and the fall-through of
+        // everything but JMP, RET, PCHL and HLT
+        std::vector<uint16_t> successors;
+    };
+
+    CodeMap(const std::array<uint8_t, 0x10000> &memory, uint16_t low,
+            uint32_t high, const std::vector<uint16_t> &entries);
+
+    bool isCode(uint16_t address) const { return code[address]; }
+    bool isInstruction(uint16_t address) const { return starts[address]; }
+    // Entry points and the targets of jumps, calls and restarts
+    bool isTarget(uint16_t address) const { return targets[address]; }
+
+    // By start address
+    const std::vector<Block> &blocks() const { return list; }
+    // The block holding `address`, or null
+    const Block *blockAt(uint16_t address) const;
+
+  private:
+    std::bitset<0x10000> code;
+    std::bitset<0x10000> starts;
+    std::bitset<0x10000> targets;
+    std::vector<Block> list;
+};
+
+#endif
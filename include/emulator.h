@@ -2,6 +2,7 @@
 #define EMULATOR_H
 
 #include <array>
+#include <atomic>
 #include <bit>
 #include <cstddef>
 #include <cstdint>
@@ -17,6 +18,32 @@ static_assert(std::endian::native == std::endian::little);
         uint16_t X##Y;                                                         \
     }
 
+enum class StopReason {
+    None,
+    Halt,
+    CycleLimit,
+    Breakpoint,
+    Watchpoint,
+    IllegalOpcode,
+    DeviceTrap,
+    HostRequest,
+};
+
+const char *toString(StopReason reason);
+
+// Why execute() returned. PC is the instruction that caused the stop, or for
+// CycleLimit and HostRequest the instruction execution will resume at.
+struct Stop {
+    StopReason reason;
+    uint16_t PC;
+    size_t cycles;
+};
+
+// A monitor for Intel8080::execute() that does nothing.
+struct NoMonitor {
+    void step(const struct Intel8080 &, uint16_t, uint8_t, size_t) {}
+};
+
 struct Intel8080 {
     uint16_t PC;
     uint16_t SP;
@@ -41,26 +68,57 @@ struct Intel8080 {
     };
 
     bool halted;
+    // The instruction that halted, reported again by execute() while halted
+    uint16_t halted_at;
     bool interrupts;
 
+    // Instructions retired since the last reset
+    uint64_t instructions;
+
     std::array<uint8_t, 0x10000> memory;
 
-    using InCallback = uint8_t(uint8_t);
+    using InCallback = uint8_t(Intel8080 &, uint8_t);
     InCallback *in_callback = nullptr;
 
-    using OutCallback = void(uint8_t, uint8_t);
+    using OutCallback = void(Intel8080 &, uint8_t, uint8_t);
     OutCallback *out_callback = nullptr;
 
     Intel8080() { reset(); }
 
     void reset();
 
-    size_t execute(size_t cycle_limit = 0);
-    size_t debug_execute(size_t cycle_limit = 0);
+    Stop execute(size_t cycle_limit = 0);
+    Stop debug_execute(size_t cycle_limit = 0);
+
+    // Like execute(), but calls monitor.step(cpu, pc, opcode, cycles) after
+    // every instruction, and monitor.before(cpu) ahead of each one if the
+    // monitor has it; raising a stop there skips the instruction. The monitor
+    // is a template parameter so it is inlined into its own copy of the loop
+    // and plain execute() stays uninstrumented.
+    template <typename Monitor>
+    Stop execute(size_t cycle_limit, Monitor &monitor);
+
+    // Stops execute() once the current instruction has finished. For use by
+    // devices and monitors on the executing thread.
+    void raise(StopReason reason) { trap = reason; }
+
+    // Stops execute() at the next slice boundary. Safe to call from any
+    // thread; a request made while nothing is executing stops the next call.
+    void requestStop() {
+        std::atomic_ref<bool>(stop_requested).store(true,
+                                                    std::memory_order_relaxed);
+    }
 
     void interrupt(size_t IQR);
 
   private:
+    // Cycles between checks for stop requests from other threads
+    static constexpr size_t SLICE_CYCLES = 0x10000;
+
+    StopReason trap = StopReason::None;
+    alignas(std::atomic_ref<bool>::required_alignment) bool stop_requested =
+        false;
+
     size_t instruction(uint8_t inst);
 
     uint8_t add(uint8_t lhs, uint8_t rhs, bool carry);
@@ -87,4 +145,53 @@ struct Intel8080 {
     uint16_t &register16(uint8_t code);
 };
 
+template <typename Monitor>
+Stop Intel8080::execute(size_t cycle_limit, Monitor &monitor) {
+    if (halted) {
+        return {StopReason::Halt, halted_at, 0};
+    }
+    trap = StopReason::None;
+    size_t cycles = 0;
+    size_t count = 0;
+    uint16_t pc = PC;
+    while (true) {
+        size_t slice = (cycle_limit == 0 || cycle_limit - cycles > SLICE_CYCLES)
+                           ? cycles + SLICE_CYCLES
+                           : cycle_limit;
+        while (trap == StopReason::None && cycles < slice) {
+            pc = PC;
+            if constexpr (requires { monitor.before(*this); }) {
+                monitor.before(*this);
+                if (trap != StopReason::None) {
+                    break;
+                }
+            }
+            uint8_t inst = memory[PC++];
+            size_t taken = instruction(inst);
+            monitor.step(*this, pc, inst, taken);
+            cycles += taken;
+            count++;
+        }
+        if (trap != StopReason::None) {
+            break;
+        }
+        pc = PC;
+        if (cycle_limit != 0 && cycles >= cycle_limit) {
+            trap = StopReason::CycleLimit;
+            break;
+        }
+        std::atomic_ref<bool> request(stop_requested);
+        if (request.load(std::memory_order_relaxed) &&
+            request.exchange(false, std::memory_order_relaxed)) {
+            trap = StopReason::HostRequest;
+            break;
+        }
+    }
+    instructions += count;
+    if (trap == StopReason::Halt) {
+        halted_at = pc;
+    }
+    return {trap, pc, cycles};
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,483 @@
+#ifndef INSTRUCTION_SET_H
+#define INSTRUCTION_SET_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Operand shapes of the 8080 instructions. Register codes go in bits 3-5
+// (destination) or 0-2 (source), register pair codes in bits 4-5.
+enum class Operands : uint8_t {
+    None,     // NOP
+    Dst,      // INR r
+    Src,      // ADD r
+    DstSrc,   // MOV r,r
+    DstByte,  // MVI r,d8
+    Pair,     // INX rp: B, D, H or SP
+    PairWord, // LXI rp,d16
+    PairBD,   // LDAX rp: B or D
+    PairPSW,  // PUSH rp: B, D, H or PSW
+    Byte,     // ADI d8, IN port
+    Word,     // JMP a16, LDA a16
+    Restart,  // RST 0-7
+};
+
+constexpr size_t operandCount(Operands operands) {
+    switch (operands) {
+    case Operands::None:
+        return 0;
+    case Operands::DstSrc:
+    case Operands::DstByte:
+    case Operands::PairWord:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+struct Mnemonic {
+    std::string_view name;
+    uint8_t opcode;
+    Operands operands;
+};
+
+// Every 8080 mnemonic with its base opcode
+inline constexpr Mnemonic MNEMONICS[] = {
+    {"aci", 0xce, Operands::Byte},      {"adc", 0x88, Operands::Src},
+    {"add", 0x80, Operands::Src},       {"adi", 0xc6, Operands::Byte},
+    {"ana", 0xa0, Operands::Src},       {"ani", 0xe6, Operands::Byte},
+    {"call", 0xcd, Operands::Word},     {"cc", 0xdc, Operands::Word},
+    {"cm", 0xfc, Operands::Word},       {"cma", 0x2f, Operands::None},
+    {"cmc", 0x3f, Operands::None},      {"cmp", 0xb8, Operands::Src},
+    {"cnc", 0xd4, Operands::Word},      {"cnz", 0xc4, Operands::Word},
+    {"cp", 0xf4, Operands::Word},       {"cpe", 0xec, Operands::Word},
+    {"cpi", 0xfe, Operands::Byte},      {"cpo", 0xe4, Operands::Word},
+    {"cz", 0xcc, Operands::Word},       {"daa", 0x27, Operands::None},
+    {"dad", 0x09, Operands::Pair},      {"dcr", 0x05, Operands::Dst},
+    {"dcx", 0x0b, Operands::Pair},      {"di", 0xf3, Operands::None},
+    {"ei", 0xfb, Operands::None},       {"hlt", 0x76, Operands::None},
+    {"in", 0xdb, Operands::Byte},       {"inr", 0x04, Operands::Dst},
+    {"inx", 0x03, Operands::Pair},      {"jc", 0xda, Operands::Word},
+    {"jm", 0xfa, Operands::Word},       {"jmp", 0xc3, Operands::Word},
+    {"jnc", 0xd2, Operands::Word},      {"jnz", 0xc2, Operands::Word},
+    {"jp", 0xf2, Operands::Word},       {"jpe", 0xea, Operands::Word},
+    {"jpo", 0xe2, Operands::Word},      {"jz", 0xca, Operands::Word},
+    {"lda", 0x3a, Operands::Word},      {"ldax", 0x0a, Operands::PairBD},
+    {"lhld", 0x2a, Operands::Word},     {"lxi", 0x01, Operands::PairWord},
+    {"mov", 0x40, Operands::DstSrc},    {"mvi", 0x06, Operands::DstByte},
+    {"nop", 0x00, Operands::None},      {"ora", 0xb0, Operands::Src},
+    {"ori", 0xf6, Operands::Byte},      {"out", 0xd3, Operands::Byte},
+    {"pchl", 0xe9, Operands::None},     {"pop", 0xc1, Operands::PairPSW},
+    {"push", 0xc5, Operands::PairPSW},  {"ral", 0x17, Operands::None},
+    {"rar", 0x1f, Operands::None},      {"rc", 0xd8, Operands::None},
+    {"ret", 0xc9, Operands::None},      {"rlc", 0x07, Operands::None},
+    {"rm", 0xf8, Operands::None},       {"rnc", 0xd0, Operands::None},
+    {"rnz", 0xc0, Operands::None},      {"rp", 0xf0, Operands::None},
+    {"rpe", 0xe8, Operands::None},      {"rpo", 0xe0, Operands::None},
+    {"rrc", 0x0f, Operands::None},      {"rst", 0xc7, Operands::Restart},
+    {"rz", 0xc8, Operands::None},       {"sbb", 0x98, Operands::Src},
+    {"sbi", 0xde, Operands::Byte},      {"shld", 0x22, Operands::Word},
+    {"sphl", 0xf9, Operands::None},     {"sta", 0x32, Operands::Word},
+    {"stax", 0x02, Operands::PairBD},   {"stc", 0x37, Operands::None},
+    {"sub", 0x90, Operands::Src},       {"sui", 0xd6, Operands::Byte},
+    {"xchg", 0xeb, Operands::None},     {"xra", 0xa8, Operands::Src},
+    {"xri", 0xee, Operands::Byte},      {"xthl", 0xe3, Operands::None},
+};
+
+// A register operand with its code as a register, as a pair for LXI/INX/DAD
+// and as a pair for PUSH/POP, or -1 where it cannot be used as such.
+struct Register {
+    std::string_view name;
+    int8_t code;
+    int8_t pair;
+    int8_t stack_pair;
+};
+
+inline constexpr Register REGISTERS[] = {
+    {"b", 0, 0, 0},     {"c", 1, -1, -1},   {"d", 2, 1, 1},
+    {"e", 3, -1, -1},   {"h", 4, 2, 2},     {"l", 5, -1, -1},
+    {"m", 6, -1, -1},   {"a", 7, -1, -1},   {"sp", -1, 3, -1},
+    {"psw", -1, -1, 3}, {"bc", -1, 0, 0},   {"de", -1, 1, 1},
+    {"hl", -1, 2, 2},
+};
+
+// Perfect hash over the names of a token table, built at compile time.
+// Tokens of up to four characters are packed into a 32-bit key, folding case,
+// and the top BITS bits of key * multiplier select a slot holding the index
+// of the only entry that can match, so a lookup is one multiply and one
+// compare.
+template <size_t N, unsigned BITS> class TokenHash {
+  public:
+    template <typename T> constexpr TokenHash(const T (&table)[N]) {
+        static_assert(N < EMPTY);
+        for (size_t i = 0; i < N; i++) {
+            keys[i] = pack(table[i].name);
+        }
+        for (multiplier = 0x9e3779b1; !place(); multiplier += 2) {
+            if (multiplier > 0x9e3779b1 + 2 * 0x10000) {
+                throw "no perfect hash for this table";
+            }
+        }
+    }
+
+    // Index of `token` in the table, or -1
+    constexpr int find(std::string_view token) const {
+        uint32_t key = pack(token);
+        uint8_t index = slots[slot(key)];
+        return index != EMPTY && keys[index] == key ? index : -1;
+    }
+
+  private:
+    static constexpr uint8_t EMPTY = 0xff;
+
+    std::array<uint32_t, N> keys{};
+    std::array<uint8_t, 1 << BITS> slots{};
+    uint32_t multiplier = 0;
+
+    static constexpr uint32_t pack(std::string_view token) {
+        if (token.empty() || token.size() > 4) {
+            return 0;
+        }
+        uint32_t key = 0;
+        for (size_t i = 0; i < token.size(); i++) {
+            char c = token[i];
+            if ('A' <= c && c <= 'Z') {
+                c |= 0x20;
+            }
+            key |= static_cast<uint32_t>(static_cast<uint8_t>(c)) << (8 * i);
+        }
+        return key;
+    }
+
+    constexpr uint32_t slot(uint32_t key) const {
+        return (key * multiplier) >> (32 - BITS);
+    }
+
+    constexpr bool place() {
+        slots.fill(EMPTY);
+        for (size_t i = 0; i < N; i++) {
+            auto &entry = slots[slot(keys[i])];
+            if (entry != EMPTY) {
+                return false;
+            }
+            entry = i;
+        }
+        return true;
+    }
+};
+
+inline constexpr TokenHash<std::size(MNEMONICS), 10> MNEMONIC_HASH(MNEMONICS);
+inline constexpr TokenHash<std::size(REGISTERS), 6> REGISTER_HASH(REGISTERS);
+
+struct Encoding {
+    uint8_t bytes[3];
+    size_t length;
+};
+
+// Encodes an instruction from its mnemonic and operand tokens. Numeric
+// operands are left to the caller: number(token, max) parses a value no
+// larger than max, and address(token, offset) resolves an address that goes
+// `offset` bytes into the instruction. Both return std::optional<uint16_t>
+// and report their own errors; anything else goes to error(message, token).
+// Returns nothing after an error.
+template <typename Number, typename Address, typename Error>
+constexpr std::optional<Encoding>
+encode(std::string_view name, const std::string_view *operands,
+       size_t operand_count, Number &&number, Address &&address,
+       Error &&error) {
+    int index = MNEMONIC_HASH.find(name);
+    if (index < 0) {
+        error("invalid opcode", name);
+        return std::nullopt;
+    }
+    const auto &mnemonic = MNEMONICS[index];
+    if (operand_count != operandCount(mnemonic.operands)) {
+        error("wrong number of operands for", name);
+        return std::nullopt;
+    }
+
+    auto reg = [&](std::string_view token) {
+        int i = REGISTER_HASH.find(token);
+        if (i < 0 || REGISTERS[i].code < 0) {
+            error("expected register, got", token);
+            return -1;
+        }
+        return int(REGISTERS[i].code);
+    };
+    auto pair = [&](std::string_view token, bool psw) {
+        int i = REGISTER_HASH.find(token);
+        int code = -1;
+        if (i >= 0) {
+            code = psw ? REGISTERS[i].stack_pair : REGISTERS[i].pair;
+        }
+        if (code < 0) {
+            error("expected register pair, got", token);
+        }
+        return code;
+    };
+
+    Encoding out{{mnemonic.opcode, 0, 0}, 1};
+    auto setWord = [&out](uint16_t value) {
+        out.bytes[1] = value & 0xff;
+        out.bytes[2] = value >> 8;
+        out.length = 3;
+    };
+    switch (mnemonic.operands) {
+    case Operands::None:
+        return out;
+    case Operands::Dst: {
+        int dst = reg(operands[0]);
+        if (dst < 0) {
+            return std::nullopt;
+        }
+        out.bytes[0] |= dst << 3;
+        return out;
+    }
+    case Operands::Src: {
+        int src = reg(operands[0]);
+        if (src < 0) {
+            return std::nullopt;
+        }
+        out.bytes[0] |= src;
+        return out;
+    }
+    case Operands::DstSrc: {
+        int dst = reg(operands[0]);
+        int src = dst < 0 ? -1 : reg(operands[1]);
+        if (src < 0) {
+            return std::nullopt;
+        }
+        if (dst == 6 && src == 6) {
+            // That encoding is HLT
+            error("invalid operands for", name);
+            return std::nullopt;
+        }
+        out.bytes[0] |= (dst << 3) | src;
+        return out;
+    }
+    case Operands::DstByte: {
+        int dst = reg(operands[0]);
+        if (dst < 0) {
+            return std::nullopt;
+        }
+        auto value = number(operands[1], 0xff);
+        if (!value) {
+            return std::nullopt;
+        }
+        out.bytes[0] |= dst << 3;
+        out.bytes[1] = *value;
+        out.length = 2;
+        return out;
+    }
+    case Operands::Pair:
+    case Operands::PairBD:
+    case Operands::PairPSW: {
+        int rp = pair(operands[0], mnemonic.operands == Operands::PairPSW);
+        if (rp < 0) {
+            return std::nullopt;
+        }
+        if (mnemonic.operands == Operands::PairBD && rp > 1) {
+            error("expected register pair B or D, got", operands[0]);
+            return std::nullopt;
+        }
+        out.bytes[0] |= rp << 4;
+        return out;
+    }
+    case Operands::PairWord: {
+        int rp = pair(operands[0], false);
+        if (rp < 0) {
+            return std::nullopt;
+        }
+        auto value = address(operands[1], 1);
+        if (!value) {
+            return std::nullopt;
+        }
+        out.bytes[0] |= rp << 4;
+        setWord(*value);
+        return out;
+    }
+    case Operands::Byte: {
+        auto value = number(operands[0], 0xff);
+        if (!value) {
+            return std::nullopt;
+        }
+        out.bytes[1] = *value;
+        out.length = 2;
+        return out;
+    }
+    case Operands::Word: {
+        auto value = address(operands[0], 1);
+        if (!value) {
+            return std::nullopt;
+        }
+        setWord(*value);
+        return out;
+    }
+    case Operands::Restart: {
+        auto n = number(operands[0], 7);
+        if (!n) {
+            return std::nullopt;
+        }
+        out.bytes[0] |= *n << 3;
+        return out;
+    }
+    }
+    return std::nullopt;
+}
+
+
+// How an instruction passes control on
+enum class Flow : uint8_t {
+    Next,              // to the following instruction
+    Jump,              // JMP a16
+    ConditionalJump,   // Jcc a16
+    Call,              // CALL a16
+    ConditionalCall,   // Ccc a16
+    Restart,           // RST n, a call to n * 8
+    Return,            // RET
+    ConditionalReturn, // Rcc
+    Indirect,          // PCHL
+    Halt,              // HLT
+};
+
+// Everything known about an opcode without executing it. `cycles` is the
+// duration when a condition does not hold and `taken_cycles` when it does;
+// they only differ for Ccc and Rcc.
+struct Opcode {
+    const Mnemonic *mnemonic;
+    uint8_t length;
+    uint8_t cycles;
+    uint8_t taken_cycles;
+    Flow flow;
+    // False for the aliases of NOP, JMP, CALL and RET in unused encodings
+    bool documented;
+};
+
+namespace detail {
+// Cycle counts as Intel8080::execute() charges them. That differs from the
+// datasheet for XTHL (10, not 18) and XCHG (5, not 4); the two have to stay
+// in step for engines built on this table to pass the lockstep checks.
+// clang-format off
+inline constexpr uint8_t CYCLES[0x100] = {
+//  x0  x1  x2  x3  x4  x5  x6  x7  x8  x9  xA  xB  xC  xD  xE  xF
+     4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 0x
+     4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4, // 1x
+     4, 10, 16,  5,  5,  5,  7,  4,  4, 10, 16,  5,  5,  5,  7,  4, // 2x
+     4, 10, 13,  5, 10, 10, 10,  4,  4, 10, 13,  5,  5,  5,  7,  4, // 3x
+     5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 4x
+     5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 5x
+     5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5, // 6x
+     7,  7,  7,  7,  7,  7,  7,  7,  5,  5,  5,  5,  5,  5,  7,  5, // 7x
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 8x
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // 9x
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Ax
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4, // Bx
+     5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11, // Cx
+     5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11, // Dx
+     5, 10, 10, 10, 11, 11,  7, 11,  5,  5, 10,  5, 11, 17,  7, 11, // Ex
+     5, 10, 10,  4, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11, // Fx
+};
+// clang-format on
+
+// The opcodes a mnemonic's base opcode covers once its operand fields are
+// filled in
+constexpr bool covers(const Mnemonic &mnemonic, uint8_t opcode) {
+    switch (mnemonic.operands) {
+    case Operands::Dst:
+    case Operands::DstByte:
+    case Operands::Restart:
+        return (opcode & 0xc7) == mnemonic.opcode;
+    case Operands::Src:
+        return (opcode & 0xf8) == mnemonic.opcode;
+    case Operands::DstSrc:
+        return (opcode & 0xc0) == mnemonic.opcode && opcode != 0x76;
+    case Operands::Pair:
+    case Operands::PairWord:
+    case Operands::PairPSW:
+        return (opcode & 0xcf) == mnemonic.opcode;
+    case Operands::PairBD:
+        return (opcode & 0xef) == mnemonic.opcode;
+    default:
+        return opcode == mnemonic.opcode;
+    }
+}
+
+constexpr const Mnemonic *findMnemonic(std::string_view name) {
+    return &MNEMONICS[MNEMONIC_HASH.find(name)];
+}
+
+constexpr std::array<Opcode, 0x100> buildOpcodes() {
+    std::array<Opcode, 0x100> opcodes{};
+    for (unsigned op = 0; op < 0x100; op++) {
+        auto &opcode = opcodes[op];
+        for (const auto &mnemonic : MNEMONICS) {
+            if (covers(mnemonic, op)) {
+                if (opcode.mnemonic != nullptr) {
+                    throw "opcode covered by two mnemonics";
+                }
+                opcode.mnemonic = &mnemonic;
+            }
+        }
+        opcode.documented = opcode.mnemonic != nullptr;
+        if (!opcode.documented) {
+            if (op < 0x40) {
+                opcode.mnemonic = findMnemonic("nop");
+            } else if (op == 0xcb) {
+                opcode.mnemonic = findMnemonic("jmp");
+            } else if (op == 0xd9) {
+                opcode.mnemonic = findMnemonic("ret");
+            } else {
+                opcode.mnemonic = findMnemonic("call");
+            }
+        }
+
+        switch (opcode.mnemonic->operands) {
+        case Operands::DstByte:
+        case Operands::Byte:
+            opcode.length = 2;
+            break;
+        case Operands::PairWord:
+        case Operands::Word:
+            opcode.length = 3;
+            break;
+        default:
+            opcode.length = 1;
+            break;
+        }
+
+        opcode.cycles = CYCLES[op];
+        opcode.taken_cycles = CYCLES[op];
+        if (op == 0x76) {
+            opcode.flow = Flow::Halt;
+        } else if (op == 0xe9) {
+            opcode.flow = Flow::Indirect;
+        } else if ((op & 0xc7) == 0xc7) {
+            opcode.flow = Flow::Restart;
+        } else if (op == 0xc3 || op == 0xcb) {
+            opcode.flow = Flow::Jump;
+        } else if ((op & 0xc7) == 0xc2) {
+            opcode.flow = Flow::ConditionalJump;
+        } else if ((op & 0xcf) == 0xcd) {
+            opcode.flow = Flow::Call;
+        } else if ((op & 0xc7) == 0xc4) {
+            opcode.flow = Flow::ConditionalCall;
+            opcode.taken_cycles = 17;
+        } else if ((op & 0xef) == 0xc9) {
+            opcode.flow = Flow::Return;
+        } else if ((op & 0xc7) == 0xc0) {
+            opcode.flow = Flow::ConditionalReturn;
+            opcode.taken_cycles = 11;
+        } else {
+            opcode.flow = Flow::Next;
+        }
+    }
+    return opcodes;
+}
+} // namespace detail
+
+// All 256 opcodes, undocumented ones decoded as the 8080 executes them
+inline constexpr std::array<Opcode, 0x100> OPCODES = detail::buildOpcodes();
+
+#endif
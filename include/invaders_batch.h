@@ -0,0 +1,94 @@
+#ifndef INVADERS_BATCH_H
+#define INVADERS_BATCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "space_invaders.h"
+
+// A batch of headless Space Invaders machines stepped a frame at a time, for
+// automated play and load testing. All machines boot from one ROM image.
+// step() applies one action per machine, runs every machine one frame on a
+// pool of worker threads, and writes the observations, scores and stop
+// reasons into contiguous per-batch buffers that are allocated once.
+class InvadersBatch {
+  public:
+    // Player 1 controls, combined as a bit mask per machine
+    enum Action : uint8_t {
+        Left = 1,
+        Right = 2,
+        Fire = 4,
+        Coin = 8,
+        Start = 16,
+    };
+
+    enum class Observation {
+        // VRAM as is: 224 columns of 32 bytes, bottom to top
+        Packed,
+        // Upright 112x128 image, one byte per pixel, 0xff where any pixel of
+        // the 2x2 block is lit
+        Downsampled,
+    };
+
+    static constexpr size_t WIDTH = 112;
+    static constexpr size_t HEIGHT = 128;
+
+    // `threads` is the number of threads stepping machines, including the
+    // caller's; 0 uses every core.
+    InvadersBatch(size_t count, const uint8_t *rom, size_t length,
+                  Observation observation = Observation::Packed,
+                  unsigned threads = 0);
+    ~InvadersBatch();
+    InvadersBatch(const InvadersBatch &) = delete;
+    InvadersBatch &operator=(const InvadersBatch &) = delete;
+
+    size_t size() const { return machines.size(); }
+
+    // Restarts every machine from the ROM image
+    void reset();
+
+    // Steps every machine one frame with actions[i] for machine i
+    void step(const uint8_t *actions);
+
+    size_t observationSize() const { return observation_size; }
+    // size() observations of observationSize() bytes each
+    const uint8_t *observations() const { return frames.data(); }
+    // Player 1 score of each machine
+    const uint32_t *scores() const { return score.data(); }
+    // Why each machine's last frame ended, CycleLimit if it ran to the end
+    const StopReason *stops() const { return stop.data(); }
+
+    SpaceInvaders &machine(size_t i) { return *machines[i]; }
+
+  private:
+    std::vector<uint8_t> rom;
+    Observation observation;
+    size_t observation_size;
+    std::vector<std::unique_ptr<SpaceInvaders>> machines;
+    std::vector<uint8_t> frames;
+    std::vector<uint32_t> score;
+    std::vector<StopReason> stop;
+    const uint8_t *actions = nullptr;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool quit = false;
+    std::atomic<size_t> next = 0;
+
+    void work();
+    void share();
+    void stepMachine(size_t i);
+    void observe(size_t i);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Lays out relocatable objects in the 8080 address space and resolves the
+// symbols they use across files; local symbols only resolve within their
+// own object. Each object is placed at its given origin
+// or right after the object added before it. Errors are collected, like the
+// assembler's.
+class Linker {
+  public:
+    // `name` is used in error messages; `object` must outlive the linker
+    void add(std::string name, const Object &object,
+             std::optional<uint16_t> origin = std::nullopt);
+
+    // The image from the lowest origin to the end of the highest object,
+    // with gaps zero-filled
+    std::vector<uint8_t> link();
+    uint16_t base() const { return lowest; }
+    // Where the `index`th object added was placed
+    uint16_t origin(size_t index) const { return sections[index].origin; }
+
+    // Address of every exported symbol, after link()
+    const std::unordered_map<std::string, uint16_t> &symbols() const {
+        return addresses;
+    }
+
+    bool hadErrors() const { return !reported.empty(); }
+    const std::vector<std::string> &errors() const { return reported; }
+
+  private:
+    struct Section {
+        std::string name;
+        const Object *object;
+        uint32_t origin;
+    };
+
+    std::vector<Section> sections;
+    std::unordered_map<std::string, uint16_t> addresses;
+    uint16_t lowest = 0;
+    std::vector<std::string> reported;
+};
+
+#endif
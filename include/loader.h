@@ -0,0 +1,53 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+uint32_t crc32(const uint8_t *data, size_t length);
+
+// Lowercase hex SHA-1 digest
+std::string sha1(const uint8_t *data, size_t length);
+
+// Known ROM and program images. A manifest is a text file with one image per
+// line, `SET FILE ADDRESS CRC32 SHA1`, with the address and CRC32 in hex and
+// `-` for a digest that is not recorded. Blank lines and lines starting with
+// `#` are ignored. Throws std::runtime_error on unreadable or malformed
+// manifests.
+class Manifest {
+  public:
+    struct Entry {
+        std::string set;
+        std::string file;
+        uint16_t address;
+        uint32_t crc32;
+        std::string sha1;
+    };
+
+    explicit Manifest(const std::filesystem::path &path);
+
+    // The entries of `set`, in manifest order
+    std::vector<Entry> set(const std::string &name) const;
+    // The entry for a file name, or nullptr
+    const Entry *find(const std::string &file) const;
+
+  private:
+    std::vector<Entry> entries;
+};
+
+// Throws std::runtime_error if `image` does not match the entry's digests
+void verify(const Manifest::Entry &entry, const MappedFile &image);
+
+// Maps every image of `set` from `dir`, verifies it and copies it to its
+// address in `memory`.
+void loadSet(const Manifest &manifest, const std::string &set,
+             const std::filesystem::path &dir,
+             std::array<uint8_t, 0x10000> &memory);
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "emulator.h"
+
+// A peripheral written as a coroutine. It runs from Machine::attach() until
+// it awaits Machine::elapsed() or Machine::written(), and is resumed by the
+// machine when the time comes or the port is written.
+class Device {
+  public:
+    struct promise_type {
+        Device get_return_object() {
+            return Device(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { throw; }
+    };
+
+    Device(Device &&other) noexcept : handle(other.handle) {
+        other.handle = nullptr;
+    }
+    Device(const Device &) = delete;
+    Device &operator=(const Device &) = delete;
+    ~Device() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+  private:
+    explicit Device(std::coroutine_handle<promise_type> handle)
+        : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+
+    friend struct Machine;
+};
+
+// An Intel8080 with I/O ports and coroutine devices driven by its cycle
+// count. run() executes the CPU up to the next device deadline, resumes the
+// devices that are due and carries on; OUT resumes the devices waiting on
+// that port before the next instruction. Waiting needs no allocation: the
+// awaiters live in the device's coroutine frame and are linked into the
+// machine's queues in place.
+//
+// IN reads the `inputs` latch of the port. Accessing a port that has not
+// been mapped stops execution with StopReason::DeviceTrap.
+struct Machine : Intel8080 {
+    struct Timer {
+        Machine &machine;
+        uint64_t deadline;
+        std::coroutine_handle<> handle = nullptr;
+        Timer *next = nullptr;
+
+        bool await_ready() const noexcept { return deadline < machine.now; }
+        void await_suspend(std::coroutine_handle<> h) {
+            handle = h;
+            machine.schedule(this);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    struct PortWrite {
+        Machine &machine;
+        uint8_t port;
+        uint8_t value = 0;
+        std::coroutine_handle<> handle = nullptr;
+        PortWrite *next = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            handle = h;
+            next = machine.writers[port];
+            machine.writers[port] = this;
+        }
+        uint8_t await_resume() const noexcept { return value; }
+    };
+
+    // Cycles executed by run(), updated between execute() slices
+    uint64_t now = 0;
+    std::array<uint8_t, 0x100> inputs{};
+
+    Machine();
+    Machine(const Machine &) = delete;
+    Machine &operator=(const Machine &) = delete;
+
+    void mapInput(uint8_t port) { readable.set(port); }
+    void mapOutput(uint8_t port) { writable.set(port); }
+
+    // Takes ownership of a device and runs it up to its first wait
+    void attach(Device device);
+
+    // Awaitable: resumes `cycles` cycles from now; elapsed(0) resumes at the
+    // start of the next run()
+    Timer elapsed(uint64_t cycles) { return {*this, now + cycles}; }
+    // Awaitable: resumes with the value of the next OUT to `port`
+    PortWrite written(uint8_t port) { return {*this, port}; }
+
+    // Executes `cycles` cycles, stopping early for anything but the limit.
+    // The returned cycle count covers the whole call.
+    Stop run(uint64_t cycles);
+    // The same with a monitor for execute(cycle_limit, monitor)
+    template <typename Monitor> Stop run(uint64_t cycles, Monitor &monitor);
+
+  private:
+    std::vector<Device> devices;
+    Timer *timers = nullptr;
+    std::array<PortWrite *, 0x100> writers{};
+    std::bitset<0x100> readable;
+    std::bitset<0x100> writable;
+
+    void schedule(Timer *timer);
+
+    static uint8_t portRead(Intel8080 &cpu, uint8_t port);
+    static void portWrite(Intel8080 &cpu, uint8_t port, uint8_t value);
+};
+
+template <typename Monitor>
+Stop Machine::run(uint64_t cycles, Monitor &monitor) {
+    uint64_t start = now;
+    uint64_t end = now + cycles;
+    Stop stop{StopReason::CycleLimit, PC, 0};
+    while (now < end) {
+        uint64_t until =
+            timers != nullptr ? std::min(timers->deadline, end) : end;
+        if (until > now) {
+            stop = execute(until - now, monitor);
+            now += stop.cycles;
+        }
+        // Timed devices see `now` as their deadline, so periodic ones do not
+        // drift by the overshoot of the instruction that crossed it
+        uint64_t actual = now;
+        while (timers != nullptr && timers->deadline <= actual) {
+            Timer *timer = timers;
+            timers = timer->next;
+            now = timer->deadline;
+            timer->handle.resume();
+        }
+        now = actual;
+        if (stop.reason != StopReason::CycleLimit) {
+            break;
+        }
+    }
+    stop.cycles = now - start;
+    return stop;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// A read-only memory mapping of a whole file. Throws std::runtime_error if
+// the file cannot be opened or mapped.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::filesystem::path &path);
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+
+  private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+};
+
+#endif
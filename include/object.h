@@ -0,0 +1,51 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// A relocatable object: code assembled from offset 0, the labels it defines
+// or uses, and a relocation for every word that holds a label's address.
+// Symbol names are lowercase. Local symbols are defined and only resolve
+// relocations of their own object. On disk, all fields little endian:
+//
+//   "O80" 0x01, u16 code size, u16 symbol count, u16 relocation count
+//   code
+//   per symbol: u16 offset, u8 flags (1 defined, 2 local), u8 name length,
+//               name
+//   per relocation: u16 offset, u16 symbol index
+//
+// Code over 0xffff bytes, a full 64 KiB, does not fit. serialize() throws
+// std::runtime_error for it; parse(), read() and write() throw it on I/O
+// errors and malformed objects.
+struct Object {
+    struct Symbol {
+        std::string name;
+        uint16_t offset;
+        bool defined;
+        bool local = false;
+    };
+
+    struct Relocation {
+        uint16_t offset;
+        uint16_t symbol;
+    };
+
+    std::vector<uint8_t> code;
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+
+    // Appends the on-disk form to `out`
+    void serialize(std::string &out) const;
+    // `name` is used in error messages
+    static Object parse(const uint8_t *data, size_t size,
+                        const std::string &name);
+
+    void write(const std::filesystem::path &path) const;
+    static Object read(const std::filesystem::path &path);
+};
+
+#endif
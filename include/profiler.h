@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "emulator.h"
+#include "instruction_set.h"
+#include "symbol_map.h"
+
+// Execution profiler for Intel8080::execute(cycle_limit, monitor). Counts
+// executions and cycles per opcode and per PC, and follows CALL/RST/RET and
+// interrupts with a shadow call stack to build call graph edges and per
+// routine cycle totals. Given a symbol map, the report names addresses and
+// also totals cycles per label and per source line.
+class Profiler {
+  public:
+    Profiler();
+
+    void step(const Intel8080 &cpu, uint16_t pc, uint8_t inst, size_t cycles) {
+        if (pc != expected || stack.empty()) {
+            // Control arrived somewhere other than where the last
+            // instruction left off, i.e. an interrupt was taken.
+            enter(pc);
+        }
+        opcode_count[inst]++;
+        opcode_cycles[inst] += cycles;
+        pc_count[pc]++;
+        pc_cycles[pc] += cycles;
+        routines[stack.back().entry].self += cycles;
+        total_cycles += cycles;
+        total_instructions++;
+
+        if (isCall(inst, cycles)) {
+            enter(cpu.PC);
+        } else if (isReturn(inst, cycles)) {
+            leave();
+        }
+        expected = cpu.PC;
+    }
+
+    void report(std::ostream &os, size_t top = 20,
+                const SymbolMap *symbols = nullptr) const;
+
+  private:
+    struct Routine {
+        uint64_t calls = 0;
+        uint64_t self = 0;
+        uint64_t inclusive = 0;
+    };
+
+    struct Frame {
+        uint16_t entry;
+        uint64_t start;
+    };
+
+    static constexpr size_t MAX_DEPTH = 1024;
+
+    std::array<uint64_t, 0x100> opcode_count{};
+    std::array<uint64_t, 0x100> opcode_cycles{};
+    std::vector<uint64_t> pc_count;
+    std::vector<uint64_t> pc_cycles;
+    std::vector<Routine> routines;
+    std::unordered_map<uint32_t, uint64_t> edges;
+    std::vector<Frame> stack;
+    uint64_t total_cycles = 0;
+    uint64_t total_instructions = 0;
+    int32_t expected = -1;
+
+    static bool isCall(uint8_t inst, size_t cycles) {
+        const auto &opcode = OPCODES[inst];
+        return opcode.flow == Flow::Call || opcode.flow == Flow::Restart ||
+               (opcode.flow == Flow::ConditionalCall &&
+                cycles == opcode.taken_cycles);
+    }
+
+    static bool isReturn(uint8_t inst, size_t cycles) {
+        const auto &opcode = OPCODES[inst];
+        return opcode.flow == Flow::Return ||
+               (opcode.flow == Flow::ConditionalReturn &&
+                cycles == opcode.taken_cycles);
+    }
+
+    void enter(uint16_t entry);
+    void leave();
+};
+
+#endif
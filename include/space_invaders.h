@@ -0,0 +1,83 @@
+#ifndef SPACE_INVADERS_H
+#define SPACE_INVADERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "machine.h"
+
+// The Space Invaders cabinet without a display: the CPU, the MB14241 shift
+// register, the input ports, the sound latches and the two video interrupts
+// per frame, each modelled as a device. The ROMs are loaded separately, see
+// loadSet() in loader.h.
+struct SpaceInvaders : Machine {
+    static constexpr uint64_t CLOCK = 2000000;
+    // RST 1 at mid-screen and RST 2 at vblank, half a frame apart
+    static constexpr uint64_t HALF_FRAME = CLOCK / 120;
+    static constexpr uint16_t VRAM = 0x2400;
+    static constexpr size_t VRAM_SIZE = 0x1c00;
+
+    struct Input {
+        union {
+            struct {
+                uint8_t credit : 1;
+                uint8_t start2 : 1;
+                uint8_t start1 : 1;
+                uint8_t : 1;
+                uint8_t shot1 : 1;
+                uint8_t left1 : 1;
+                uint8_t right1 : 1;
+                uint8_t : 1;
+            };
+            uint8_t value;
+        } port1;
+
+        union {
+            struct {
+                uint8_t dip3 : 1;
+                uint8_t dip5 : 1;
+                uint8_t tilt : 1;
+                uint8_t dip6 : 1;
+                uint8_t shot2 : 1;
+                uint8_t left2 : 1;
+                uint8_t right2 : 1;
+                uint8_t dip7 : 1;
+            };
+            uint8_t value;
+        } port2;
+    };
+
+    // Sampled at the start of every frame
+    Input input{};
+    // Last values written to the sound ports 3 and 5
+    uint8_t sound[2] = {};
+    uint64_t frames = 0;
+
+    SpaceInvaders();
+
+    // Latches the input and runs to the end of the next frame
+    Stop frame() { return run(startFrame()); }
+    template <typename Monitor> Stop frame(Monitor &monitor) {
+        return run(startFrame(), monitor);
+    }
+
+    const uint8_t *vram() const { return memory.data() + VRAM; }
+    // Fast non-cryptographic hash of VRAM for regression checks. Values are
+    // only comparable between little-endian hosts.
+    uint64_t vramHash() const;
+
+  private:
+    uint64_t frame_end = 0;
+    uint16_t shift_data = 0;
+    uint8_t shift_offset = 0;
+
+    // Latches the input and returns the cycles left to the end of the frame
+    uint64_t startFrame();
+
+    Device shiftOffset();
+    Device shiftData();
+    Device soundLatch(uint8_t port, uint8_t &latch);
+    Device video();
+};
+
+#endif
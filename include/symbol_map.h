@@ -0,0 +1,67 @@
+#ifndef SYMBOL_MAP_H
+#define SYMBOL_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Maps guest addresses back to the labels and source lines they were
+// assembled from, as written by `bin/asm -m`. Lookups binary search tables
+// sorted by address, so they can be done per record or per PC when a trace
+// or profile is reported. On disk, all fields little endian:
+//
+//   "M80" 0x01, u16 file count, u16 symbol count, u32 line count
+//   per file: u16 name length, name
+//   per symbol: u16 address, u8 name length, name
+//   per line: u16 address, u8 size, u16 file index, u32 line number
+//
+// read() and write() throw std::runtime_error on I/O errors and malformed
+// maps.
+class SymbolMap {
+  public:
+    struct Symbol {
+        uint16_t address;
+        std::string name;
+    };
+
+    // A source line that assembled to `size` bytes at `address`
+    struct Line {
+        uint16_t address;
+        uint8_t size;
+        uint16_t file;
+        uint32_t number;
+    };
+
+    // Returns the index to pass to addLine()
+    uint16_t addFile(std::string name);
+    void addSymbol(std::string name, uint16_t address);
+    void addLine(uint16_t file, uint32_t number, uint16_t address,
+                 uint8_t size);
+    // Sorts everything added so far; lookups need it
+    void sort();
+
+    // The closest label at or below `address` if it is assembled code, or
+    // null
+    const Symbol *symbolAt(uint16_t address) const;
+    // The line whose bytes include `address`, or null
+    const Line *lineAt(uint16_t address) const;
+    const std::string &fileName(const Line &line) const {
+        return files[line.file];
+    }
+    // "label+offset file:line", either part left out if unknown
+    std::string describe(uint16_t address) const;
+    // Every label, by address
+    const std::vector<Symbol> &labels() const { return symbols; }
+
+    void write(const std::filesystem::path &path) const;
+    static SymbolMap read(const std::filesystem::path &path);
+
+  private:
+    std::vector<std::string> files;
+    std::vector<Symbol> symbols;
+    std::vector<Line> lines;
+};
+
+#endif
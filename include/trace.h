@@ -0,0 +1,99 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "emulator.h"
+#include "mapped_file.h"
+
+// One executed instruction: the PC and opcode it was fetched with, the
+// machine state after it retired, and the running cycle count.
+struct TraceRecord {
+    uint64_t cycles;
+    uint16_t PC;
+    uint8_t opcode;
+    uint8_t reserved;
+    uint16_t PSW;
+    uint16_t BC;
+    uint16_t DE;
+    uint16_t HL;
+    uint16_t SP;
+    uint16_t stack; // word at SP
+};
+
+static_assert(sizeof(TraceRecord) == 24);
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+};
+
+// Formats a record like Intel8080::debug_execute, without a newline.
+std::string formatRecord(const TraceRecord &record);
+
+// Binary execution trace monitor for Intel8080::execute(cycle_limit, monitor).
+// Records are written straight into either a memory-mapped trace file, which
+// grows as needed, or a preallocated ring that keeps the most recent records.
+class Tracer {
+  public:
+    explicit Tracer(const std::filesystem::path &path);
+    explicit Tracer(size_t capacity);
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+    ~Tracer();
+
+    void step(const Intel8080 &cpu, uint16_t pc, uint8_t inst, size_t cycles) {
+        if (next == end) {
+            advance();
+        }
+        total_cycles += cycles;
+        uint16_t stack = cpu.memory[cpu.SP] |
+                         (cpu.memory[static_cast<uint16_t>(cpu.SP + 1)] << 8);
+        *next++ = {total_cycles, pc,     inst,   0,     cpu.PSW,
+                   cpu.BC,       cpu.DE, cpu.HL, cpu.SP, stack};
+    }
+
+    // Number of records currently held
+    uint64_t count() const;
+
+    // Writes a ring buffer out as a trace file, oldest record first.
+    void save(const std::filesystem::path &path) const;
+
+  private:
+    int fd = -1;
+    TraceHeader *header = nullptr;
+    size_t capacity = 0;
+    std::vector<TraceRecord> ring;
+    bool wrapped = false;
+
+    TraceRecord *begin = nullptr;
+    TraceRecord *next = nullptr;
+    TraceRecord *end = nullptr;
+    uint64_t total_cycles = 0;
+
+    void advance();
+    void map(size_t records);
+};
+
+// A trace file opened for reading.
+class TraceReader {
+  public:
+    explicit TraceReader(const std::filesystem::path &path);
+
+    const TraceRecord *begin() const { return records; }
+    const TraceRecord *end() const { return records + length; }
+    size_t size() const { return length; }
+
+  private:
+    MappedFile file;
+    const TraceRecord *records;
+    size_t length;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "access_map.h"
+
+const AccessMap::Operands &AccessMap::probeOperands() {
+    static const Operands operands = [] {
+        // Distinct register values tell which one an address came from
+        auto cpu = std::make_unique<Intel8080>();
+        cpu->BC = 0x1000;
+        cpu->DE = 0x2000;
+        cpu->HL = 0x3000;
+        cpu->SP = 0x4000;
+        cpu->memory[cpu->PC + 1] = 0x00;
+        cpu->memory[cpu->PC + 2] = 0x50;
+        const std::pair<uint16_t, Base> bases[] = {
+            {0x1000, BC}, {0x2000, DE},   {0x3000, HL},
+            {0x4000, SP}, {0x3ffe, Push}, {0x5000, Direct}};
+        Operands operands{};
+        for (size_t op = 0; op < operands.size(); op++) {
+            auto &operand = operands[op];
+            cpu->memory[cpu->PC] = op;
+            Debugger::MemoryAccess out[2];
+            cpu->PSW = 0;
+            size_t n = Debugger::accesses(*cpu, out);
+            // A condition tests one flag, so try each bit on its own
+            for (int bit = 0; bit < 8 && operand.flag == 0; bit++) {
+                cpu->PSW = 1 << bit;
+                size_t with = Debugger::accesses(*cpu, out);
+                if (with != n) {
+                    operand.flag = 1 << bit;
+                    operand.when = with != 0 ? operand.flag : 0;
+                    n = std::max(n, with);
+                }
+            }
+            if (n == 0) {
+                continue;
+            }
+            cpu->PSW = operand.when;
+            Debugger::accesses(*cpu, out);
+            auto base = std::find_if(
+                std::begin(bases), std::end(bases),
+                [&](const auto &base) { return base.first == out[0].address; });
+            if (base == std::end(bases)) {
+                throw std::logic_error("no operand base for opcode " +
+                                       std::to_string(op));
+            }
+            operand.base = base->second;
+            operand.access = out[0].access;
+            operand.width = n;
+        }
+        return operands;
+    }();
+    return operands;
+}
+
+AccessMap::AccessMap(bool per_byte) : operands(probeOperands()) {
+    if (per_byte) {
+        byte_counts.resize(0x10000);
+    }
+}
+
+void AccessMap::codeWrite(uint16_t pc, uint16_t address) {
+    auto [it, added] = writes.try_emplace(address, CodeWrite{pc});
+    it->second.writes++;
+    state[address] |= Written;
+    // The instruction covering it, starting up to two bytes before, is
+    // marked again when it next runs
+    for (uint16_t start = address - 2, i = 0; i < 3; start++, i++) {
+        state[start] &= ~Opcode;
+    }
+}
+
+void AccessMap::markExecuted(uint16_t pc, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint16_t address = pc + i;
+        if (state[address] & Written) {
+            writes.at(address).runs++;
+        }
+        state[address] = Executed | (state[address] & Opcode);
+    }
+    state[pc] |= Opcode;
+}
+
+void AccessMap::report(std::ostream &os, size_t top,
+                       const SymbolMap *symbols) const {
+    auto total = [](const Counts &c) {
+        return c.reads + c.writes + c.executes;
+    };
+    Counts sum;
+    size_t used = 0;
+    for (const auto &page : page_counts) {
+        sum.reads += page.reads;
+        sum.writes += page.writes;
+        sum.executes += page.executes;
+        used += total(page) != 0;
+    }
+    auto flags = os.flags();
+    os << std::dec << sum.reads << " reads, " << sum.writes << " writes, "
+       << sum.executes << " instructions in " << used << " pages"
+       << std::endl;
+
+    std::vector<size_t> busiest(page_counts.size());
+    std::iota(busiest.begin(), busiest.end(), 0);
+    busiest.erase(std::remove_if(busiest.begin(), busiest.end(),
+                                 [&](size_t i) {
+                                     return total(page_counts[i]) == 0;
+                                 }),
+                  busiest.end());
+    top = std::min(top, busiest.size());
+    std::partial_sort(busiest.begin(), busiest.begin() + top, busiest.end(),
+                      [&](size_t a, size_t b) {
+                          return total(page_counts[a]) >
+                                 total(page_counts[b]);
+                      });
+    busiest.resize(top);
+    os << std::endl << "Pages" << std::endl;
+    os << "  PAGE        reads       writes     executes" << std::endl;
+    for (auto page : busiest) {
+        const auto &counts = page_counts[page];
+        os << "  " << std::hex << std::setfill('0') << std::setw(2) << page
+           << "xx" << std::dec << std::setfill(' ') << std::setw(13)
+           << counts.reads << std::setw(13) << counts.writes << std::setw(13)
+           << counts.executes << std::endl;
+    }
+
+    os << std::endl << "Writes to executed code" << std::endl;
+    if (writes.empty()) {
+        os << "  none" << std::endl;
+    } else {
+        os << "  ADDR      writes         runs  WRITER"
+           << (symbols ? "  WHERE" : "") << std::endl;
+    }
+    for (const auto &[address, write] : writes) {
+        os << "  " << std::hex << std::setfill('0') << std::setw(4) << address
+           << std::dec << std::setfill(' ') << std::setw(12) << write.writes
+           << std::setw(13) << write.runs << "  " << std::hex
+           << std::setfill('0') << std::setw(4) << write.writer;
+        if (symbols != nullptr) {
+            os << "  " << symbols->describe(address) << " <- "
+               << symbols->describe(write.writer);
+        }
+        os << std::endl;
+    }
+    os.flags(flags);
+}
+
+void AccessMap::writeHeatmap(const std::filesystem::path &path) const {
+    std::ofstream os(path);
+    os << "address,reads,writes,executes\n";
+    auto row = [&os](size_t address, const Counts &c) {
+        if (c.reads + c.writes + c.executes != 0) {
+            os << std::hex << std::setfill('0') << std::setw(4) << address
+               << std::dec << "," << c.reads << "," << c.writes << ","
+               << c.executes << "\n";
+        }
+    };
+    if (byte_counts.empty()) {
+        for (size_t page = 0; page < page_counts.size(); page++) {
+            row(page << 8, page_counts[page]);
+        }
+    } else {
+        for (size_t address = 0; address < byte_counts.size(); address++) {
+            row(address, byte_counts[address]);
+        }
+    }
+    if (!os) {
+        throw std::runtime_error("could not write '" + path.string() + "'");
+    }
+}
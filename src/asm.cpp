@@ -1,33 +1,349 @@
-#include "assembler.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-int main(int argc, char **argv) {
-    if (argc != 3) {
-        std::cerr << "usage: " << argv[0] << " INPUT OUTPUT" << std::endl;
-        return 1;
+#include "assembler.h"
+#include "assembly_cache.h"
+#include "linker.h"
+#include "mapped_file.h"
+#include "symbol_map.h"
+
+namespace {
+// A file given on the command line and what became of it
+struct Unit {
+    std::filesystem::path path;
+    std::optional<uint16_t> origin;
+    Object object;
+    std::vector<std::string> errors;
+    // Kept for a listing or symbol map; `lines` point into `source`
+    std::optional<MappedFile> source;
+    std::vector<Intel8080Assembler::Line> lines;
+    uint16_t placed = 0;
+};
+
+std::string_view view(const MappedFile &file) {
+    return {reinterpret_cast<const char *>(file.data()), file.size()};
+}
+
+void build(Unit &unit, bool write, bool keep_lines) {
+    try {
+        if (unit.path.extension() == ".o") {
+            unit.object = Object::read(unit.path);
+            return;
+        }
+        MappedFile source(unit.path);
+        Intel8080Assembler assembler(view(source));
+        if (keep_lines) {
+            assembler.keepLines();
+        }
+        unit.object = assembler.assembleObject();
+        for (const auto &error : assembler.errors()) {
+            unit.errors.push_back(unit.path.string() + ":" +
+                                  std::to_string(error.line) +
+                                  ": error: " + error.message);
+        }
+        if (write && !assembler.hadErrors()) {
+            unit.object.write(
+                std::filesystem::path(unit.path).replace_extension(".o"));
+        }
+        if (keep_lines) {
+            unit.lines = assembler.lines();
+            unit.source.emplace(std::move(source));
+        }
+    } catch (std::runtime_error &e) {
+        unit.errors.push_back(e.what());
     }
-    std::ifstream input(argv[1]);
-    if (!input) {
-        std::cerr << "Failed to open input file '" << argv[1] << "'"
+}
+
+bool writeFile(const char *path, const std::vector<uint8_t> &data) {
+    std::ofstream output(path, std::ios::binary);
+    if (!output) {
+        std::cerr << "Failed to open output file '" << path << "'"
                   << std::endl;
+        return false;
+    }
+    if (!output.write((char *)data.data(), data.size())) {
+        std::cerr << "Failed to write to '" << path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Each line of each source with its address and the bytes it assembled to
+void writeListing(const char *path, const std::vector<Unit> &units,
+                  const std::vector<uint8_t> &image, uint16_t base) {
+    std::ofstream os(path);
+    os << std::hex << std::uppercase << std::setfill('0');
+    for (const auto &unit : units) {
+        if (units.size() > 1) {
+            os << "; " << unit.path.string() << "\n";
+        }
+        for (const auto &line : unit.lines) {
+            uint16_t address = unit.placed + line.offset;
+            os << std::setw(4) << address << " ";
+            for (size_t i = 0; i < 3; i++) {
+                if (i < line.size) {
+                    os << " " << std::setw(2) << +image[address - base + i];
+                } else {
+                    os << "   ";
+                }
+            }
+            auto text = line.text;
+            if (!text.empty() && text.back() == '\r') {
+                text.remove_suffix(1);
+            }
+            os << "  " << text << "\n";
+        }
+    }
+    if (!os.flush()) {
+        throw std::runtime_error("could not write '" + std::string(path) +
+                                 "'");
+    }
+}
+
+void writeSymbolMap(
+    const char *path, const std::vector<Unit> &units,
+    const std::vector<std::pair<std::string, uint16_t>> &symbols) {
+    SymbolMap map;
+    for (const auto &unit : units) {
+        uint16_t file = map.addFile(unit.path.string());
+        for (const auto &line : unit.lines) {
+            if (line.size > 0) {
+                map.addLine(file, line.number, unit.placed + line.offset,
+                            line.size);
+            }
+        }
+    }
+    for (const auto &[name, address] : symbols) {
+        map.addSymbol(name, address);
+    }
+    map.sort();
+    map.write(path);
+}
+
+// Assembles one source into a flat binary at address 0, reusing the chunks
+// in `cache` if one is given
+int assembleFlat(const char *input, const char *output, const char *cache,
+                 const char *listing, const char *symbol_map) {
+    std::optional<MappedFile> source;
+    try {
+        source.emplace(input);
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
         return 1;
     }
-    Intel8080Assembler assembler(input);
-    auto program = assembler.assemble();
-    if (assembler.hadErrors()) {
-        std::cerr << "'" << argv[1] << "' had errors" << std::endl;
+    std::vector<uint8_t> program;
+    std::vector<std::string> errors;
+    if (cache != nullptr) {
+        AssemblyCache chunks(cache);
+        program = chunks.assemble(view(*source), input, errors);
+        if (errors.empty()) {
+            try {
+                chunks.save();
+            } catch (std::runtime_error &e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        }
+    } else {
+        Intel8080Assembler assembler(view(*source));
+        if (listing != nullptr || symbol_map != nullptr) {
+            assembler.keepLines();
+        }
+        program = assembler.assemble();
+        for (const auto &error : assembler.errors()) {
+            errors.push_back(std::string(input) + ":" +
+                             std::to_string(error.line) +
+                             ": error: " + error.message);
+        }
+        if (errors.empty()) {
+            std::vector<Unit> units(1);
+            units[0].path = input;
+            units[0].lines = assembler.lines();
+            std::vector<std::pair<std::string, uint16_t>> symbols;
+            for (const auto &[label, address] : assembler.labels()) {
+                symbols.emplace_back(label, address);
+            }
+            try {
+                if (listing != nullptr) {
+                    writeListing(listing, units, program, 0);
+                }
+                if (symbol_map != nullptr) {
+                    writeSymbolMap(symbol_map, units, symbols);
+                }
+            } catch (std::runtime_error &e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (!errors.empty()) {
+        for (const auto &error : errors) {
+            std::cerr << error << std::endl;
+        }
+        std::cerr << "'" << input << "' had errors" << std::endl;
         return 1;
     }
-    std::ofstream output(argv[2], std::ios::binary);
-    if (!output) {
-        std::cerr << "Failed to open output file '" << argv[2] << "'"
-                  << std::endl;
+    return writeFile(output, program) ? 0 : 1;
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name << " [-l LISTING] [-m MAP] INPUT OUTPUT"
+              << std::endl
+              << "       " << name << " -i CACHE INPUT OUTPUT" << std::endl
+              << "       " << name << " [-j THREADS] -c SOURCE..." << std::endl
+              << "       " << name
+              << " [-j THREADS] [-l LISTING] [-m MAP] -o OUTPUT "
+                 "FILE[@ORIGIN]..."
+              << std::endl
+              << "  -l LISTING  write each line's address and bytes to LISTING"
+              << std::endl
+              << "  -m MAP      write labels and line addresses to MAP for "
+                 "the tracing and"
+              << std::endl
+              << "              profiling tools" << std::endl
+              << "  -i CACHE    reassemble only what changed since the last "
+                 "run with CACHE"
+              << std::endl
+              << "  -j THREADS  number of files to assemble at once"
+              << std::endl
+              << "  -c          write an object (.o) beside each source"
+              << std::endl
+              << "  -o OUTPUT   link the files into a binary starting at the "
+                 "lowest origin"
+              << std::endl
+              << "  FILE        a source, or an object written by -c"
+              << std::endl
+              << "  @ORIGIN     hex address of FILE, by default right after "
+                 "the previous file"
+              << std::endl;
+    return 1;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool compile = false;
+    const char *output = nullptr;
+    const char *cache = nullptr;
+    const char *listing = nullptr;
+    const char *symbol_map = nullptr;
+    std::vector<Unit> units;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-c") == 0) {
+            compile = true;
+        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            cache = argv[++i];
+        } else if (std::strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            listing = argv[++i];
+        } else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            symbol_map = argv[++i];
+        } else if (argv[i][0] == '-') {
+            return usage(argv[0]);
+        } else {
+            auto &unit = units.emplace_back();
+            std::string_view arg = argv[i];
+            size_t at = arg.rfind('@');
+            unit.path = arg.substr(0, at);
+            if (at != std::string_view::npos) {
+                uint16_t origin;
+                auto end = arg.data() + arg.size();
+                auto [ptr, ec] =
+                    std::from_chars(arg.data() + at + 1, end, origin, 16);
+                if (ec != std::errc() || ptr != end) {
+                    std::cerr << "invalid origin in '" << arg << "'"
+                              << std::endl;
+                    return 1;
+                }
+                unit.origin = origin;
+            }
+        }
+    }
+    bool keep_lines = listing != nullptr || symbol_map != nullptr;
+    if (!compile && output == nullptr) {
+        if (units.size() != 2 || units[0].origin || units[1].origin ||
+            (cache != nullptr && keep_lines)) {
+            return usage(argv[0]);
+        }
+        return assembleFlat(units[0].path.c_str(), units[1].path.c_str(),
+                            cache, listing, symbol_map);
+    }
+    if (units.empty() || (compile && output != nullptr) || cache != nullptr ||
+        (compile && keep_lines)) {
+        return usage(argv[0]);
+    }
+
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers;
+    threads = std::min<size_t>(threads, units.size());
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (size_t i = next++; i < units.size(); i = next++) {
+                build(units[i], compile, keep_lines);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    bool failed = false;
+    for (const auto &unit : units) {
+        for (const auto &error : unit.errors) {
+            std::cerr << error << std::endl;
+        }
+        failed |= !unit.errors.empty();
+    }
+    if (failed || compile) {
+        return failed ? 1 : 0;
+    }
+
+    Linker linker;
+    for (const auto &unit : units) {
+        linker.add(unit.path.string(), unit.object, unit.origin);
+    }
+    auto image = linker.link();
+    if (linker.hadErrors()) {
+        for (const auto &error : linker.errors()) {
+            std::cerr << "error: " << error << std::endl;
+        }
         return 1;
     }
-    if (!output.write((char *)program.data(), program.size())) {
-        std::cerr << "Failed to write to '" << argv[2] << "'" << std::endl;
+    // Every label, local ones included, at its linked address
+    std::vector<std::pair<std::string, uint16_t>> symbols;
+    for (size_t i = 0; i < units.size(); i++) {
+        units[i].placed = linker.origin(i);
+        for (const auto &symbol : units[i].object.symbols) {
+            if (symbol.defined) {
+                symbols.emplace_back(symbol.name,
+                                     units[i].placed + symbol.offset);
+            }
+        }
+    }
+    try {
+        if (listing != nullptr) {
+            writeListing(listing, units, image, linker.base());
+        }
+        if (symbol_map != nullptr) {
+            writeSymbolMap(symbol_map, units, symbols);
+        }
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
         return 1;
     }
-    return 0;
-}
\ No newline at end of file
+    return writeFile(output, image) ? 0 : 1;
+}
@@ -1,319 +1,212 @@
-#include <fstream>
-#include <iomanip>
-#include <iostream>
+#include <algorithm>
+#include <charconv>
 #include <sstream>
 
 #include "assembler.h"
+#include "instruction_set.h"
+
+size_t
+Intel8080Assembler::FoldedHash::operator()(std::string_view token) const {
+    // FNV-1a
+    size_t hash = 0xcbf29ce484222325;
+    for (char c : token) {
+        hash = (hash ^ static_cast<uint8_t>(syntax::fold(c))) * 0x100000001b3;
+    }
+    return hash;
+}
 
 std::vector<uint8_t> Intel8080Assembler::assemble() {
     std::vector<uint8_t> program;
-    while (!is.eof()) {
-        try {
-            assembleLine(program);
-        } catch (std::runtime_error &e) {
-            std::cerr << e.what() << std::endl;
-        }
-    }
+    assembleLines(program);
     fixBranches(program);
     return program;
 }
 
-void Intel8080Assembler::assembleLine(std::vector<uint8_t> &program) {
-    std::vector<std::string> tokens = parseLine();
-
-    auto it = tokens.cbegin();
-    if (it == tokens.cend()) {
-        return;
-    }
+Object Intel8080Assembler::assembleObject(bool export_local) {
+    Object object;
+    assembleLines(object.code);
 
-    if (it->back() == ':') {
-        auto label = it->substr(0, it->size() - 1);
-        if (!label2addr.emplace(label, program.size()).second) {
-            error("label '", label, "' already defined");
+    auto isLocal = [export_local](std::string_view label) {
+        return !export_local && label[0] == '@';
+    };
+    std::unordered_map<std::string_view, uint16_t, FoldedHash, FoldedEqual>
+        indices;
+    auto addSymbol = [&](std::string_view label, uint16_t offset,
+                         bool defined) {
+        std::string name(label);
+        for (auto &c : name) {
+            c = syntax::fold(c);
+        }
+        indices.emplace(label, object.symbols.size());
+        object.symbols.push_back(
+            {std::move(name), offset, defined, defined && isLocal(label)});
+    };
+    for (const auto &[label, address] : labels()) {
+        addSymbol(label, address, true);
+    }
+    for (const auto &fixup : addr2fix) {
+        auto it = indices.find(fixup.label);
+        if (it == indices.end() && isLocal(fixup.label)) {
+            line_number = fixup.line;
+            error("could not resolve local label '", fixup.label, "'");
+            continue;
         }
-        it++;
-        if (it == tokens.cend()) {
-            error("expected instruction after label '", label, "'");
+        if (it == indices.end()) {
+            addSymbol(fixup.label, 0, false);
+            it = indices.find(fixup.label);
         }
+        object.relocations.push_back({fixup.location, it->second});
     }
+    return object;
+}
 
-    auto code = *it++;
+std::vector<std::pair<std::string_view, uint16_t>>
+Intel8080Assembler::labels() const {
+    std::vector<std::pair<std::string_view, uint16_t>> sorted(
+        label2addr.begin(), label2addr.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto &a, const auto &b) { return a.second < b.second; });
+    return sorted;
+}
 
-    std::string operand1, operand2;
-    size_t operand_count = 0;
-    if (it != tokens.cend()) {
-        operand1 = *it++;
-        operand_count++;
-        if (it != tokens.cend()) {
-            operand2 = *it++;
-            operand_count++;
+void Intel8080Assembler::assembleLines(std::vector<uint8_t> &program) {
+    program.reserve(source.size() / 4);
+    for (size_t start = 0; start < source.size();) {
+        size_t end = source.find('\n', start);
+        if (end == std::string_view::npos) {
+            end = source.size();
+        }
+        line_number++;
+        auto syntaxError = [this](std::string_view message,
+                                  std::string_view token) {
+            if (token.empty()) {
+                error(message);
+            } else {
+                error(message, " '", token, "'");
+            }
+        };
+        auto text = source.substr(start, end - start);
+        size_t offset = program.size();
+        if (syntax::lexLine(text, line, syntaxError)) {
+            assembleLine(program);
+        }
+        if (keep_lines) {
+            kept.push_back({line_number, uint16_t(offset),
+                            uint8_t(program.size() - offset), text});
         }
+        start = end + 1;
     }
-
-    if (it != tokens.cend()) {
-        error("unexpected token '", *it, "' after operand");
+    if (program.size() > 0x10000) {
+        error("program is larger than 64 KiB");
     }
+}
 
-    auto assertOperandCountIs = [&, this](size_t expected) {
-        if (operand_count != expected) {
-            error("opcode '", code, "' expects ", expected, " operands");
+bool Intel8080Assembler::assembleLine(std::vector<uint8_t> &program) {
+    if (!line.label.empty()) {
+        if (!label2addr.emplace(line.label, program.size()).second) {
+            return error("label '", line.label, "' already defined");
         }
-    };
+    }
+    if (line.mnemonic.empty()) {
+        return true;
+    }
 
-    auto emitByte = [&program](uint8_t byte) { program.push_back(byte); };
-    auto emitWord = [&program](uint16_t word) {
-        program.push_back(word & 0xff);
-        program.push_back((word >> 8) & 0xff);
+    auto number = [this](std::string_view token, uint16_t max) {
+        return parseNumber(token, max);
     };
-
-    if (code == "cpi") {
-        assertOperandCountIs(1);
-        emitByte(0xfe);
-        emitByte(parseImmediate(operand1));
-    } else if (code == "hlt") {
-        assertOperandCountIs(0);
-        emitByte(0x76);
-    } else if (code == "in") {
-        assertOperandCountIs(1);
-        emitByte(0xdb);
-        emitByte(parseImmediate(operand1));
-    } else if (code == "inx") {
-        assertOperandCountIs(1);
-        uint8_t rp = parseRegisterPair(operand1);
-        emitByte(0x03 | (rp << 4));
-    } else if (code == "jmp") {
-        assertOperandCountIs(1);
-        emitByte(0xc3);
-        auto address = parseAddress(operand1);
-        if (address.has_value()) {
-            emitWord(address.value());
-        } else {
-            addr2fix.emplace(operand1, program.size());
-            emitWord(0);
-        }
-    } else if (code == "ldax") {
-        assertOperandCountIs(1);
-        uint8_t rp = parseRegisterPair(operand1);
-        if (rp != 0 && rp != 1) {
-            error("invalid operand for opcode 'ldax'");
-        }
-        emitByte(0x0a | (rp << 4));
-    } else if (code == "mov") {
-        assertOperandCountIs(2);
-        uint8_t dst = parseRegister(operand1);
-        uint8_t src = parseRegister(operand2);
-        if (dst == 6 && src == 6) {
-            error("invalid operands for opcode 'mov'");
-        }
-        emitByte(0x40 | (dst << 3) | src);
-    } else if (code == "nop") {
-        assertOperandCountIs(0);
-        emitByte(0x00);
-    } else if (code == "out") {
-        assertOperandCountIs(1);
-        emitByte(0xd3);
-        emitByte(parseImmediate(operand1));
-    } else if (code == "ret") {
-        assertOperandCountIs(0);
-        emitByte(0xc9);
-    } else if (code == "xchg") {
-        assertOperandCountIs(0);
-        emitByte(0xeb);
-    } else {
-        if (code[0] == 'j') {
-            auto condition = code.substr(1, code.size() - 1);
-            static const std::unordered_map<std::string, uint8_t> conditions = {
-                {"nz", 0}, {"z", 1},  {"nc", 2}, {"c", 3},
-                {"po", 4}, {"pe", 5}, {"p", 6},  {"m", 7},
-            };
-            auto it = conditions.find(condition);
-            if (it == conditions.end()) {
-                error("invalid condition '", condition, "'");
-            }
-            uint8_t ccc = it->second;
-            if (code[0] == 'j') {
-                assertOperandCountIs(1);
-                emitByte(0xc2 | (ccc << 3));
-                auto address = parseAddress(operand1);
-                if (address.has_value()) {
-                    emitWord(address.value());
-                } else {
-                    addr2fix.emplace(operand1, program.size());
-                    emitWord(0);
-                }
-                return;
-            }
+    auto address = [&, this](std::string_view token,
+                             size_t offset) -> std::optional<uint16_t> {
+        if (syntax::isDigit(token[0]) || token[0] == '\'') {
+            return parseNumber(token, 0xffff);
         }
-        error("invalid opcode '", code, "'");
-    }
+        // Every use is a fixup, as it becomes a relocation in an object
+        addr2fix.push_back(
+            {token, uint16_t(program.size() + offset), line_number});
+        return 0;
+    };
+    auto encodingError = [this](std::string_view message,
+                                std::string_view token) {
+        error(message, " '", token, "'");
+    };
+    auto encoding = encode(line.mnemonic, line.operands, line.operand_count,
+                           number, address, encodingError);
+    if (!encoding) {
+        return false;
+    }
+    program.insert(program.end(), encoding->bytes,
+                   encoding->bytes + encoding->length);
+    return true;
 }
 
 void Intel8080Assembler::fixBranches(std::vector<uint8_t> &program) {
-    for (const auto [label, loc] : addr2fix) {
-        auto it = label2addr.find(label);
+    for (const auto &fixup : addr2fix) {
+        auto it = label2addr.find(fixup.label);
         if (it == label2addr.end()) {
-            std::cerr << "error: could not resolve label '" << label << "'"
-                      << std::endl;
+            line_number = fixup.line;
+            error("could not resolve label '", fixup.label, "'");
         } else {
             auto address = it->second;
-            program[loc] = address & 0xff;
-            program[loc + 1] = (address >> 8) & 0xff;
+            program[fixup.location] = address & 0xff;
+            program[fixup.location + 1] = (address >> 8) & 0xff;
         }
     }
 }
 
-std::vector<std::string> Intel8080Assembler::parseLine() {
-    static const auto whitespace = std::string(" \t\v\f\r");
-
-    line_number++;
-    std::getline(is, line, '\n');
-    for (auto &c : line) {
-        c = std::tolower(c);
-    }
-
-    size_t start = line.find_first_not_of(whitespace, 0);
-    size_t end = line.find_first_of(whitespace, start);
-
-    std::vector<std::string> tokens;
-    if (start == std::string::npos) {
-        return tokens;
-    }
-
-    if (line[end - 1] == ':') {
-        tokens.push_back(line.substr(start, end - start));
-    } else {
-        end = 0;
-    }
-
-    start = line.find_first_not_of(whitespace, end);
-    end = line.find_first_of(whitespace, start);
-
-    if (start == std::string::npos) {
-        error("expected instruction after label");
-    } else {
-        tokens.push_back(line.substr(start, end - start));
-    }
-
-    start = line.find_first_not_of(whitespace, end);
-    if (start == std::string::npos || line[start] == ';') {
-        return tokens;
-    }
-
-    end = line.find_first_of(whitespace + ",", start);
-    tokens.push_back(line.substr(start, end - start));
-
-    if (line[end] == ',') {
-        start = line.find_first_not_of(whitespace, end + 1);
-        end = line.find_first_of(whitespace, start);
-        tokens.push_back(line.substr(start, end - start));
-    }
-
-    start = line.find_first_not_of(whitespace, end);
-    if (start != std::string::npos && line[start] != ';') {
-        error("expected comment or end of line");
-    }
-
-    return tokens;
-}
-
-std::optional<uint16_t> Intel8080Assembler::parseAddress(std::string token) {
-    if ('0' < token[0] && token[0] < '9') {
-        try {
-            int base = 10;
-            switch (token.back()) {
-            case 'h':
-                base = 16;
-                break;
-            case 'o':
-                base = 8;
-                break;
-            case 'b':
-                base = 2;
-                break;
-            }
-            int imm = std::stoi(token, nullptr, base);
-            if (imm < 0 || imm > 0x10000) {
-                throw std::out_of_range("");
-            }
-            return static_cast<uint16_t>(imm);
-        } catch (std::invalid_argument &e) {
-            error("could not parse immediate value");
-        } catch (std::out_of_range &e) {
-            error("immedate value is out of range (0-255)");
-        }
-    }
-
-    auto it = label2addr.find(token);
-    if (it == label2addr.end()) {
-        return std::nullopt;
-    }
-    return it->second;
-}
-
-uint8_t Intel8080Assembler::parseImmediate(std::string token) {
+std::optional<uint16_t> Intel8080Assembler::parseNumber(std::string_view token,
+                                                        uint16_t max) {
+    unsigned value;
     if (token[0] == '\'') {
-        if (token.size() == 3 && token[2] == '\'') {
-            return static_cast<uint8_t>(token[1]);
-        } else {
-            error("invalid ascii literal");
+        if (token.size() != 3 || token[2] != '\'') {
+            error("invalid ascii literal ", token);
+            return std::nullopt;
+        }
+        value = static_cast<uint8_t>(token[1]);
+    } else {
+        if (!syntax::isDigit(token[0])) {
+            error("could not parse number '", token, "'");
+            return std::nullopt;
         }
-    }
-
-    try {
         int base = 10;
-        switch (token.back()) {
-        case 'H':
+        size_t length = token.size();
+        switch (syntax::fold(token.back())) {
+        case 'h':
             base = 16;
+            length--;
             break;
-        case 'O':
+        case 'o':
+        case 'q':
             base = 8;
+            length--;
             break;
-        case 'B':
+        case 'b':
             base = 2;
+            length--;
+            break;
+        case 'd':
+            length--;
             break;
         }
-        int imm = std::stoi(token, nullptr, base);
-        if (imm < 0 || imm > 255) {
-            throw std::out_of_range("");
+        auto digits = token.substr(0, length);
+        auto end = digits.data() + digits.size();
+        auto [ptr, ec] = std::from_chars(digits.data(), end, value, base);
+        if (ec == std::errc::result_out_of_range) {
+            value = max + 1u;
+        } else if (ec != std::errc() || ptr != end) {
+            error("could not parse number '", token, "'");
+            return std::nullopt;
         }
-        return static_cast<uint8_t>(imm);
-    } catch (std::invalid_argument &e) {
-        error("could not parse immediate value");
-    } catch (std::out_of_range &e) {
-        error("immedate value is out of range (0-255)");
     }
-    error("internal error");
-    return 0;
-}
-
-uint8_t Intel8080Assembler::parseRegister(std::string token) {
-    static const std::unordered_map<std::string, uint8_t> registers = {
-        {"a", 7}, {"b", 0}, {"c", 1}, {"d", 2},
-        {"e", 3}, {"f", 4}, {"l", 5}, {"m", 6}};
-
-    auto it = registers.find(token);
-    if (it == registers.end()) {
-        error("expected register operand, got '", token, "'");
-    }
-    return it->second;
-}
-
-uint8_t Intel8080Assembler::parseRegisterPair(std::string token) {
-    static const std::unordered_map<std::string, uint8_t> registers = {
-        {"bc", 0}, {"de", 1}, {"hl", 2}, {"sp", 3}};
-
-    auto it = registers.find(token);
-    if (it == registers.end()) {
-        error("expected register operand, got '", token, "'");
+    if (value > max) {
+        error("value '", token, "' is out of range (0-", max, ")");
+        return std::nullopt;
     }
-    return it->second;
+    return value;
 }
 
-template <typename... Ts> void Intel8080Assembler::error(Ts... args) {
-    had_errors = true;
+template <typename... Ts>
+bool Intel8080Assembler::error(const Ts &...args) {
     std::ostringstream os;
-    os << line_number << ": error: ";
-    int unpack[]{0, ((os << args), 0)...};
-    static_cast<void>(unpack);
-    throw std::runtime_error(os.str());
-}
\ No newline at end of file
+    (os << ... << args);
+    reported.push_back({line_number, os.str()});
+    return false;
+}
@@ -0,0 +1,185 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "assembler.h"
+#include "assembly_cache.h"
+#include "linker.h"
+#include "mapped_file.h"
+
+namespace {
+constexpr char MAGIC[4] = {'A', '8', '0', 'C'};
+
+// A chunk ends after a line whose hash has these bits clear, so chunks are
+// 64 lines on average, or after MAX_CHUNK_LINES lines
+constexpr uint64_t BOUNDARY_MASK = 63;
+constexpr size_t MAX_CHUNK_LINES = 1024;
+
+constexpr uint64_t SEED = 0xcbf29ce484222325;
+
+uint64_t hashLine(std::string_view line) {
+    // FNV-1a
+    uint64_t hash = SEED;
+    for (char c : line) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+    hash = (hash ^ value) * 0xff51afd7ed558ccd;
+    return hash ^ (hash >> 32);
+}
+} // namespace
+
+AssemblyCache::AssemblyCache(std::filesystem::path path)
+    : path(std::move(path)) {
+    if (!std::filesystem::exists(this->path)) {
+        return;
+    }
+    try {
+        MappedFile file(this->path);
+        const uint8_t *data = file.data();
+        size_t size = file.size();
+        auto take = [&](void *out, size_t length) {
+            if (size < length) {
+                throw std::runtime_error("truncated");
+            }
+            std::memcpy(out, data, length);
+            data += length;
+            size -= length;
+        };
+        char magic[sizeof(MAGIC)];
+        uint32_t count;
+        take(magic, sizeof(magic));
+        take(&count, sizeof(count));
+        if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("bad magic");
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t key;
+            uint32_t length;
+            take(&key, sizeof(key));
+            take(&length, sizeof(length));
+            if (size < length) {
+                throw std::runtime_error("truncated");
+            }
+            entries[key].object =
+                Object::parse(data, length, this->path.string());
+            data += length;
+            size -= length;
+        }
+    } catch (std::runtime_error &) {
+        entries.clear();
+    }
+}
+
+std::vector<uint8_t> AssemblyCache::assemble(std::string_view source,
+                                             const std::string &name,
+                                             std::vector<std::string> &errors) {
+    hit = 0;
+    missed = 0;
+    for (auto &[key, entry] : entries) {
+        entry.used = false;
+    }
+
+    Linker linker;
+    bool failed = false;
+    size_t chunk_start = 0;
+    size_t first_line = 1;
+    size_t line = 1;
+    uint64_t key = SEED;
+    auto addChunk = [&](size_t end) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            auto text = source.substr(chunk_start, end - chunk_start);
+            Intel8080Assembler assembler(text, first_line);
+            // Chunks are one source, so its local labels span them
+            auto object = assembler.assembleObject(true);
+            for (const auto &error : assembler.errors()) {
+                errors.push_back(name + ":" + std::to_string(error.line) +
+                                 ": error: " + error.message);
+            }
+            if (assembler.hadErrors()) {
+                failed = true;
+                return;
+            }
+            it = entries.emplace(key, Entry{std::move(object)}).first;
+            missed++;
+            dirty = true;
+        } else {
+            hit++;
+        }
+        it->second.used = true;
+        linker.add(name + ":" + std::to_string(first_line) + "-" +
+                       std::to_string(line - 1),
+                   it->second.object);
+    };
+
+    for (size_t start = 0; start < source.size();) {
+        size_t end = source.find('\n', start);
+        if (end == std::string_view::npos) {
+            end = source.size();
+        }
+        uint64_t hash = hashLine(source.substr(start, end - start));
+        key = mix(key, hash);
+        start = end + 1;
+        line++;
+        if ((hash & BOUNDARY_MASK) == 0 ||
+            line - first_line == MAX_CHUNK_LINES || start >= source.size()) {
+            addChunk(std::min(start, source.size()));
+            chunk_start = start;
+            first_line = line;
+            key = SEED;
+        }
+    }
+    if (failed) {
+        return {};
+    }
+
+    auto image = linker.link();
+    for (const auto &error : linker.errors()) {
+        errors.push_back("error: " + error);
+    }
+    return image;
+}
+
+void AssemblyCache::save() {
+    for (const auto &[key, entry] : entries) {
+        // Drop chunks the source no longer has
+        dirty |= !entry.used;
+    }
+    if (!dirty) {
+        return;
+    }
+
+    std::string out(MAGIC, sizeof(MAGIC));
+    uint32_t count = 0;
+    out.append(sizeof(count), 0);
+    for (const auto &[key, entry] : entries) {
+        if (!entry.used) {
+            continue;
+        }
+        size_t header = out.size();
+        out.append(sizeof(key) + sizeof(uint32_t), 0);
+        entry.object.serialize(out);
+        uint32_t length = out.size() - header - sizeof(key) - sizeof(length);
+        std::memcpy(&out[header], &key, sizeof(key));
+        std::memcpy(&out[header + sizeof(key)], &length, sizeof(length));
+        count++;
+    }
+    std::memcpy(&out[sizeof(MAGIC)], &count, sizeof(count));
+
+    // Replace the old cache only once the new one is complete
+    auto temporary = path;
+    temporary += ".tmp";
+    std::ofstream os(temporary, std::ios::binary);
+    os.write(out.data(), out.size());
+    os.close();
+    if (!os) {
+        throw std::runtime_error("could not write '" + temporary.string() +
+                                 "'");
+    }
+    std::filesystem::rename(temporary, path);
+    dirty = false;
+}
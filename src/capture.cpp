@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "capture.h"
+
+Capture::Capture(const std::filesystem::path &path, Format format,
+                 unsigned fps, size_t frames_per_buffer)
+    : os(path, std::ios::binary), format(format),
+      capacity(std::max<size_t>(frames_per_buffer, 1)) {
+    if (!os) {
+        throw std::runtime_error("could not open '" + path.string() + "'");
+    }
+    if (format == Format::Y4M) {
+        os << "YUV4MPEG2 W" << WIDTH << " H" << HEIGHT << " F" << fps
+           << ":1 Ip A1:1 Cmono\n";
+    }
+    front.vram.resize(capacity * VRAM_SIZE);
+    back.vram.resize(capacity * VRAM_SIZE);
+    if (format != Format::Packed) {
+        expanded.resize(capacity * (WIDTH * HEIGHT + 6));
+    }
+    writer = std::thread([this] {
+        std::unique_lock lock(mutex);
+        while (true) {
+            cv.wait(lock, [this] { return busy || quit; });
+            if (!busy) {
+                return;
+            }
+            lock.unlock();
+            write();
+            lock.lock();
+            busy = false;
+            cv.notify_all();
+        }
+    });
+}
+
+Capture::~Capture() {
+    if (writer.joinable()) {
+        try {
+            close();
+        } catch (std::runtime_error &) {
+        }
+    }
+}
+
+Capture::Format Capture::formatFor(const std::filesystem::path &path) {
+    auto extension = path.extension();
+    if (extension == ".y4m") {
+        return Format::Y4M;
+    } else if (extension == ".gray") {
+        return Format::Gray;
+    }
+    return Format::Packed;
+}
+
+void Capture::add(const uint8_t *vram) {
+    if (failed) {
+        throw std::runtime_error(error);
+    }
+    std::memcpy(front.vram.data() + front.count * VRAM_SIZE, vram, VRAM_SIZE);
+    front.count++;
+    added++;
+    if (front.count == capacity) {
+        swap();
+    }
+}
+
+void Capture::close() {
+    if (!writer.joinable()) {
+        return;
+    }
+    if (front.count > 0 && !failed) {
+        try {
+            swap();
+        } catch (std::runtime_error &) {
+            // Thrown below once the writer has stopped
+        }
+    }
+    {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this] { return !busy; });
+        quit = true;
+    }
+    cv.notify_all();
+    writer.join();
+    os.close();
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+void Capture::swap() {
+    std::unique_lock lock(mutex);
+    if (busy) {
+        waited++;
+        cv.wait(lock, [this] { return !busy; });
+    }
+    if (!error.empty()) {
+        // The frames in front are lost; later adds throw too
+        front.count = 0;
+        failed = true;
+        throw std::runtime_error(error);
+    }
+    std::swap(front, back);
+    front.count = 0;
+    busy = true;
+    cv.notify_all();
+}
+
+// Runs on the writer thread
+void Capture::write() {
+    const uint8_t *data = back.vram.data();
+    size_t length = back.count * VRAM_SIZE;
+    if (format != Format::Packed) {
+        uint8_t *out = expanded.data();
+        for (size_t i = 0; i < back.count; i++) {
+            if (format == Format::Y4M) {
+                std::memcpy(out, "FRAME\n", 6);
+                out += 6;
+            }
+            expand(back.vram.data() + i * VRAM_SIZE, out);
+            out += WIDTH * HEIGHT;
+        }
+        data = expanded.data();
+        length = out - expanded.data();
+    }
+    if (!os.write(reinterpret_cast<const char *>(data), length)) {
+        std::lock_guard lock(mutex);
+        error = "could not write capture";
+    }
+}
+
+// VRAM is 224 columns of 256 pixels, bottom to top
+void Capture::expand(const uint8_t *vram, uint8_t *out) const {
+    // Y4M luma is studio swing
+    uint8_t black = format == Format::Y4M ? 16 : 0;
+    uint8_t white = format == Format::Y4M ? 235 : 255;
+    for (size_t x = 0; x < WIDTH; x++) {
+        for (size_t k = 0; k < HEIGHT / 8; k++) {
+            uint8_t bits = vram[x * HEIGHT / 8 + k];
+            for (size_t bit = 0; bit < 8; bit++) {
+                size_t y = HEIGHT - 1 - (k * 8 + bit);
+                out[y * WIDTH + x] = (bits >> bit) & 1 ? white : black;
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "console.h"
+
+void Console::write(const uint8_t *data, size_t length) {
+    buffer.append(reinterpret_cast<const char *>(data), length);
+    if (buffer.size() >= limit ||
+        (mode == Mode::Interactive &&
+         std::find(data, data + length, '\n') != data + length)) {
+        flush();
+    }
+}
+
+void Console::flush() {
+    if (mode == Mode::Capture || buffer.empty()) {
+        return;
+    }
+    sink->write(buffer.data(), buffer.size());
+    if (mode == Mode::Interactive) {
+        sink->flush();
+    }
+    buffer.clear();
+}
+
+void Console::setMode(Mode mode) {
+    flush();
+    this->mode = mode;
+    limit = mode == Mode::Capture ? SIZE_MAX : BUFFER_SIZE;
+}
+
+void Console::setSink(std::ostream &sink) {
+    flush();
+    this->sink = &sink;
+}
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+#include "constexpr_assembler.h"
+#include "cpm.h"
+
+namespace {
+// File control block field offsets
+constexpr uint16_t FCB_NAME = 1;
+constexpr uint16_t FCB_EX = 12;
+constexpr uint16_t FCB_RC = 15;
+constexpr uint16_t FCB_CR = 32;
+constexpr uint16_t FCB_R0 = 33;
+
+constexpr size_t RECORD_SIZE = 128;
+constexpr uint8_t END_OF_FILE = 0x1a;
+
+// Warm boot (JMP 0000H) ends the program; CALL 5 jumps to the trap stub at
+// the top of the TPA
+constexpr auto PAGE_ZERO = assemble8080<R"(
+        HLT
+        NOP
+        NOP
+        NOP
+        NOP
+        JMP 0FE00H
+)">();
+static_assert(PAGE_ZERO[6] == (CPM::BDOS & 0xff) &&
+              PAGE_ZERO[7] == CPM::BDOS >> 8);
+
+constexpr auto BDOS_STUB = assemble8080<R"(
+        OUT 0FFH
+        RET
+)">();
+static_assert(BDOS_STUB[1] == CPM::BDOS_PORT);
+} // namespace
+
+CPM::CPM() { out_callback = bdosTrap; }
+
+void CPM::load(const uint8_t *program, size_t length) {
+    reset();
+    memory.fill(0);
+    std::copy(PAGE_ZERO.begin(), PAGE_ZERO.end(), memory.begin());
+    std::copy(BDOS_STUB.begin(), BDOS_STUB.end(), memory.begin() + BDOS);
+    std::copy_n(program, std::min<size_t>(length, BDOS - TPA),
+                memory.begin() + TPA);
+    // Returning from the program also warm boots
+    SP = BDOS;
+    memory[--SP] = 0x00;
+    memory[--SP] = 0x00;
+    PC = TPA;
+    dma = DEFAULT_DMA;
+    files.clear();
+}
+
+void CPM::bdosTrap(Intel8080 &cpu, uint8_t port, uint8_t) {
+    if (port == BDOS_PORT) {
+        static_cast<CPM &>(cpu).bdos();
+    }
+}
+
+void CPM::bdos() {
+    uint16_t result = 0;
+    switch (C) {
+    case 0:
+        // System reset
+        halted = true;
+        raise(StopReason::Halt);
+        break;
+    case 1:
+        // Console input
+        result = consoleInput();
+        console.put(result);
+        break;
+    case 2:
+        // Console output
+        console.put(E);
+        break;
+    case 6:
+        // Direct console I/O
+        if (E == 0xff) {
+            result = std::cin.rdbuf()->in_avail() > 0 ? consoleInput() : 0;
+        } else if (E != 0xfe) {
+            console.put(E);
+        }
+        break;
+    case 9:
+        // Print string
+        printString(DE);
+        break;
+    case 10:
+        // Read console buffer
+        readConsoleBuffer(DE);
+        break;
+    case 11:
+        // Console status
+        result = std::cin.rdbuf()->in_avail() > 0 ? 0xff : 0x00;
+        break;
+    case 12:
+        // Return version number
+        result = 0x0022;
+        break;
+    case 13:
+        // Reset disk system
+        dma = DEFAULT_DMA;
+        break;
+    case 14:
+        // Select disk
+        break;
+    case 15:
+        // Open file
+        result = openFile(DE, false);
+        break;
+    case 16:
+        // Close file
+        result = closeFile(DE);
+        break;
+    case 17:
+    case 18:
+        // Search for first/next
+        result = 0xff;
+        break;
+    case 19:
+        // Delete file
+        result = deleteFile(DE);
+        break;
+    case 20:
+        // Read sequential
+        result = readRecord(DE, sequentialRecord(DE));
+        if (result == 0) {
+            advanceSequential(DE);
+        }
+        break;
+    case 21:
+        // Write sequential
+        result = writeRecord(DE, sequentialRecord(DE));
+        if (result == 0) {
+            advanceSequential(DE);
+        }
+        break;
+    case 22:
+        // Make file
+        result = openFile(DE, true);
+        break;
+    case 25:
+        // Return current disk
+        result = 0;
+        break;
+    case 26:
+        // Set DMA address
+        dma = DE;
+        break;
+    case 33:
+        // Read random
+        result = readRecord(DE, randomRecord(DE));
+        break;
+    case 34:
+    case 40:
+        // Write random
+        result = writeRecord(DE, randomRecord(DE));
+        break;
+    case 35:
+        // Compute file size
+        result = fileSize(DE);
+        break;
+    case 36: {
+        // Set random record
+        uint32_t record = sequentialRecord(DE);
+        memory[static_cast<uint16_t>(DE + FCB_R0)] = record & 0xff;
+        memory[static_cast<uint16_t>(DE + FCB_R0 + 1)] = (record >> 8) & 0xff;
+        memory[static_cast<uint16_t>(DE + FCB_R0 + 2)] = (record >> 16) & 0xff;
+        break;
+    }
+    default:
+        result = 0xff;
+        break;
+    }
+    A = L = result & 0xff;
+    B = H = result >> 8;
+}
+
+uint16_t CPM::consoleInput() {
+    console.flush();
+    int c = std::cin.get();
+    return c == EOF ? END_OF_FILE : static_cast<uint8_t>(c);
+}
+
+void CPM::printString(uint16_t address) {
+    uint16_t end = address;
+    while (memory[end] != '$' && end < memory.size() - 1) {
+        end++;
+    }
+    console.write(&memory[address], end - address);
+}
+
+void CPM::readConsoleBuffer(uint16_t address) {
+    console.flush();
+    std::string line;
+    std::getline(std::cin, line);
+    uint8_t length = std::min<size_t>(line.size(), memory[address]);
+    memory[static_cast<uint16_t>(address + 1)] = length;
+    for (size_t i = 0; i < length; i++) {
+        memory[static_cast<uint16_t>(address + 2 + i)] = line[i];
+    }
+}
+
+std::string CPM::fileName(uint16_t fcb) {
+    auto field = [this, fcb](uint16_t offset, uint16_t length) {
+        std::string s;
+        for (uint16_t i = 0; i < length; i++) {
+            char c = memory[static_cast<uint16_t>(fcb + offset + i)] & 0x7f;
+            if (c != ' ') {
+                s += std::toupper(c);
+            }
+        }
+        return s;
+    };
+    std::string name = field(FCB_NAME, 8);
+    std::string type = field(FCB_NAME + 8, 3);
+    return type.empty() ? name : name + "." + type;
+}
+
+std::filesystem::path CPM::hostPath(const std::string &name) const {
+    auto path = root / name;
+    if (!std::filesystem::exists(path)) {
+        std::string lower = name;
+        for (auto &c : lower) {
+            c = std::tolower(c);
+        }
+        path = root / lower;
+    }
+    return path;
+}
+
+uint16_t CPM::openFile(uint16_t fcb, bool create) {
+    auto name = fileName(fcb);
+    auto path = hostPath(name);
+
+    auto mode = std::ios::in | std::ios::out | std::ios::binary;
+    if (create) {
+        mode |= std::ios::trunc;
+    }
+    std::fstream file(path, mode);
+    if (!file && !create) {
+        file.open(path, std::ios::in | std::ios::binary);
+    }
+    if (!file) {
+        return 0xff;
+    }
+    files.insert_or_assign(name, std::move(file));
+
+    memory[static_cast<uint16_t>(fcb + FCB_EX)] = 0;
+    memory[static_cast<uint16_t>(fcb + FCB_CR)] = 0;
+    memory[static_cast<uint16_t>(fcb + FCB_RC)] =
+        std::min<uintmax_t>(std::filesystem::file_size(path) / RECORD_SIZE,
+                            0x80);
+    return 0;
+}
+
+uint16_t CPM::closeFile(uint16_t fcb) {
+    return files.erase(fileName(fcb)) ? 0 : 0xff;
+}
+
+uint16_t CPM::deleteFile(uint16_t fcb) {
+    auto name = fileName(fcb);
+    files.erase(name);
+    std::error_code ec;
+    return std::filesystem::remove(hostPath(name), ec) ? 0 : 0xff;
+}
+
+uint16_t CPM::readRecord(uint16_t fcb, uint32_t record) {
+    auto it = files.find(fileName(fcb));
+    if (it == files.end()) {
+        return 9;
+    }
+    auto &file = it->second;
+    char buffer[RECORD_SIZE];
+    file.clear();
+    file.seekg(record * RECORD_SIZE);
+    file.read(buffer, RECORD_SIZE);
+    size_t count = file.gcount();
+    if (count == 0) {
+        return 1;
+    }
+    std::fill(buffer + count, buffer + RECORD_SIZE, END_OF_FILE);
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        memory[static_cast<uint16_t>(dma + i)] = buffer[i];
+    }
+    return 0;
+}
+
+uint16_t CPM::writeRecord(uint16_t fcb, uint32_t record) {
+    auto it = files.find(fileName(fcb));
+    if (it == files.end()) {
+        return 9;
+    }
+    auto &file = it->second;
+    char buffer[RECORD_SIZE];
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        buffer[i] = memory[static_cast<uint16_t>(dma + i)];
+    }
+    file.clear();
+    file.seekp(record * RECORD_SIZE);
+    return file.write(buffer, RECORD_SIZE) ? 0 : 2;
+}
+
+uint16_t CPM::fileSize(uint16_t fcb) {
+    auto it = files.find(fileName(fcb));
+    if (it == files.end()) {
+        return 0xff;
+    }
+    auto &file = it->second;
+    file.clear();
+    file.seekg(0, std::ios::end);
+    uint32_t records = (static_cast<uint32_t>(file.tellg()) + RECORD_SIZE - 1) /
+                       RECORD_SIZE;
+    memory[static_cast<uint16_t>(fcb + FCB_R0)] = records & 0xff;
+    memory[static_cast<uint16_t>(fcb + FCB_R0 + 1)] = (records >> 8) & 0xff;
+    memory[static_cast<uint16_t>(fcb + FCB_R0 + 2)] = (records >> 16) & 0xff;
+    return 0;
+}
+
+uint32_t CPM::sequentialRecord(uint16_t fcb) {
+    return memory[static_cast<uint16_t>(fcb + FCB_EX)] * 0x80 +
+           memory[static_cast<uint16_t>(fcb + FCB_CR)];
+}
+
+void CPM::advanceSequential(uint16_t fcb) {
+    if (++memory[static_cast<uint16_t>(fcb + FCB_CR)] == 0x80) {
+        memory[static_cast<uint16_t>(fcb + FCB_CR)] = 0;
+        memory[static_cast<uint16_t>(fcb + FCB_EX)]++;
+    }
+}
+
+uint32_t CPM::randomRecord(uint16_t fcb) {
+    return memory[static_cast<uint16_t>(fcb + FCB_R0)] |
+           (memory[static_cast<uint16_t>(fcb + FCB_R0 + 1)] << 8) |
+           (memory[static_cast<uint16_t>(fcb + FCB_R0 + 2)] << 16);
+}
@@ -0,0 +1,214 @@
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpm.h"
+#include "debugger.h"
+#include "disassembler.h"
+#include "mapped_file.h"
+
+// Command line debugger for COM programs under the CP/M environment.
+
+const char *help =
+    "b ADDR                 set a breakpoint\n"
+    "w ADDR [LEN] [r|w|rw]  watch LEN bytes for reads and/or writes "
+    "(default 1, w)\n"
+    "d ADDR                 delete the breakpoint or watchpoints at ADDR\n"
+    "l                      list breakpoints and watchpoints\n"
+    "c                      continue\n"
+    "s [COUNT]              step COUNT instructions\n"
+    "r                      show registers\n"
+    "x ADDR [LEN]           dump memory\n"
+    "u [ADDR] [COUNT]       disassemble COUNT instructions (default PC, 8)\n"
+    "q                      quit\n";
+
+std::ostream &hex(std::ostream &os, unsigned value, int width) {
+    return os << std::hex << std::setfill('0') << std::setw(width) << value
+              << std::dec;
+}
+
+void registers(const Intel8080 &cpu) {
+    std::cout << "PC=";
+    hex(std::cout, cpu.PC, 4) << "[";
+    hex(std::cout, cpu.memory[cpu.PC], 2) << "] A=";
+    hex(std::cout, cpu.A, 2) << " SZAPC=" << (int)cpu.FLAGS.S
+                             << (int)cpu.FLAGS.Z << (int)cpu.FLAGS.A
+                             << (int)cpu.FLAGS.P << (int)cpu.FLAGS.C << " BC=";
+    hex(std::cout, cpu.BC, 4) << " DE=";
+    hex(std::cout, cpu.DE, 4) << " HL=";
+    hex(std::cout, cpu.HL, 4) << " SP=";
+    hex(std::cout, cpu.SP, 4) << "  "
+                              << disassemble(decode(cpu.memory, cpu.PC))
+                              << std::endl;
+}
+
+void unassemble(const Intel8080 &cpu, uint16_t address, unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        auto instruction = decode(cpu.memory, address);
+        hex(std::cout, address, 4) << "  " << disassemble(instruction)
+                                   << std::endl;
+        address = instruction.next();
+    }
+}
+
+void dump(const Intel8080 &cpu, uint16_t address, uint32_t length) {
+    for (uint32_t i = 0; i < length; i += 16) {
+        hex(std::cout, static_cast<uint16_t>(address + i), 4) << ":";
+        for (uint32_t j = i; j < std::min(i + 16, length); j++) {
+            std::cout << " ";
+            hex(std::cout, cpu.memory[static_cast<uint16_t>(address + j)], 2);
+        }
+        std::cout << std::endl;
+    }
+}
+
+const char *accessName(uint8_t access) {
+    switch (access) {
+    case Debugger::Read:
+        return "r";
+    case Debugger::Write:
+        return "w";
+    default:
+        return "rw";
+    }
+}
+
+void report(const Debugger &debugger, const Stop &stop) {
+    std::cout << toString(stop.reason) << " at ";
+    hex(std::cout, stop.PC, 4);
+    if (stop.reason == StopReason::Watchpoint) {
+        std::cout << " (" << accessName(debugger.hit().access) << " ";
+        hex(std::cout, debugger.hit().address, 4) << ")";
+    }
+    std::cout << std::endl;
+}
+
+// Runs one command, returns false to quit
+bool command(CPM &cpm, Debugger &debugger, const std::string &line) {
+    std::istringstream is(line);
+    std::string name;
+    if (!(is >> name)) {
+        return true;
+    }
+    is >> std::hex;
+    unsigned address = 0, length = 1;
+    std::string mode;
+    if (name == "b" && is >> address) {
+        debugger.addBreakpoint(address);
+    } else if (name == "w" && is >> address) {
+        is >> length >> mode;
+        uint8_t access = mode == "r"    ? Debugger::Read
+                         : mode == "rw" ? Debugger::Read | Debugger::Write
+                                        : Debugger::Write;
+        debugger.addWatchpoint(address, length, access);
+    } else if (name == "d" && is >> address) {
+        bool removed = debugger.removeBreakpoint(address);
+        removed |= debugger.removeWatchpoint(address);
+        if (!removed) {
+            std::cout << "nothing at " << std::hex << address << std::dec
+                      << std::endl;
+        }
+    } else if (name == "l") {
+        for (auto address : debugger.breakpoints()) {
+            std::cout << "break ";
+            hex(std::cout, address, 4) << std::endl;
+        }
+        for (const auto &w : debugger.watchpoints()) {
+            std::cout << "watch ";
+            hex(std::cout, w.address, 4)
+                << " " << std::hex << w.length << std::dec << " "
+                << accessName(w.access) << std::endl;
+        }
+    } else if (name == "c") {
+        report(debugger, debugger.run());
+        cpm.console.flush();
+    } else if (name == "s") {
+        is >> std::dec >> length;
+        Stop stop{StopReason::None, cpm.PC, 0};
+        for (unsigned i = 0; i < length; i++) {
+            stop = debugger.step();
+            if (stop.reason != StopReason::CycleLimit) {
+                break;
+            }
+        }
+        cpm.console.flush();
+        if (stop.reason != StopReason::CycleLimit) {
+            report(debugger, stop);
+        }
+        registers(cpm);
+    } else if (name == "r") {
+        registers(cpm);
+    } else if (name == "x" && is >> address) {
+        is >> length;
+        dump(cpm, address, length);
+    } else if (name == "u") {
+        length = 8;
+        if (!(is >> address)) {
+            address = cpm.PC;
+        }
+        is >> std::dec >> length;
+        unassemble(cpm, address, length);
+    } else if (name == "q") {
+        return false;
+    } else {
+        std::cout << help;
+    }
+    return true;
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name << " [-e COMMAND]... COM" << std::endl
+              << "  -e COMMAND  run COMMAND before reading commands from "
+                 "standard input"
+              << std::endl
+              << "Commands:" << std::endl
+              << help;
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> commands;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            commands.push_back(argv[++i]);
+        } else if (argv[i][0] == '-' || path != nullptr) {
+            return usage(argv[0]);
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        return usage(argv[0]);
+    }
+
+    auto cpm = std::make_unique<CPM>();
+    cpm->console.setMode(Console::Mode::Interactive);
+    try {
+        MappedFile com(path);
+        cpm->load(com.data(), com.size());
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    Debugger debugger(*cpm);
+    registers(*cpm);
+
+    for (const auto &line : commands) {
+        if (!command(*cpm, debugger, line)) {
+            return 0;
+        }
+    }
+    std::string line;
+    while (std::cout << "> " << std::flush && std::getline(std::cin, line)) {
+        if (!command(*cpm, debugger, line)) {
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+
+#include "debugger.h"
+
+struct Debugger::Monitor {
+    Debugger &debugger;
+    int resume;
+    bool pending = false;
+
+    void before(Intel8080 &cpu) {
+        uint16_t pc = cpu.PC;
+        if (debugger.breaks[pc] && pc != resume) {
+            cpu.raise(StopReason::Breakpoint);
+            return;
+        }
+        resume = -1;
+        if (debugger.watches.empty()) {
+            return;
+        }
+        MemoryAccess out[2];
+        size_t n = accesses(cpu, out);
+        for (size_t i = 0; i < n; i++) {
+            if (debugger.watched(out[i])) {
+                debugger.last_hit = out[i];
+                pending = true;
+                return;
+            }
+        }
+    }
+
+    void step(const Intel8080 &, uint16_t, uint8_t, size_t) {
+        if (pending) {
+            pending = false;
+            debugger.cpu.raise(StopReason::Watchpoint);
+        }
+    }
+};
+
+void Debugger::addBreakpoint(uint16_t address) { breaks.set(address); }
+
+bool Debugger::removeBreakpoint(uint16_t address) {
+    bool was = breaks[address];
+    breaks.reset(address);
+    return was;
+}
+
+std::vector<uint16_t> Debugger::breakpoints() const {
+    std::vector<uint16_t> list;
+    for (size_t address = 0; address < breaks.size(); address++) {
+        if (breaks[address]) {
+            list.push_back(address);
+        }
+    }
+    return list;
+}
+
+void Debugger::addWatchpoint(uint16_t address, uint32_t length,
+                             uint8_t access) {
+    length = std::clamp<uint32_t>(length, 1, 0x10000 - address);
+    watches.push_back({address, length, access});
+    updatePages();
+}
+
+bool Debugger::removeWatchpoint(uint16_t address) {
+    auto end = std::remove_if(
+        watches.begin(), watches.end(),
+        [address](const Watchpoint &w) { return w.address == address; });
+    bool removed = end != watches.end();
+    watches.erase(end, watches.end());
+    updatePages();
+    return removed;
+}
+
+void Debugger::updatePages() {
+    pages.fill(0);
+    for (const auto &w : watches) {
+        for (uint32_t page = w.address >> 8;
+             page <= (w.address + w.length - 1) >> 8; page++) {
+            pages[page] |= w.access;
+        }
+    }
+}
+
+bool Debugger::watched(MemoryAccess access) const {
+    if ((pages[access.address >> 8] & access.access) == 0) {
+        return false;
+    }
+    return std::any_of(watches.begin(), watches.end(),
+                       [access](const Watchpoint &w) {
+                           uint32_t offset = access.address - w.address;
+                           return (w.access & access.access) != 0 &&
+                                  access.address >= w.address &&
+                                  offset < w.length;
+                       });
+}
+
+Stop Debugger::run(size_t cycle_limit) {
+    if (!armed()) {
+        return cpu.execute(cycle_limit);
+    }
+    Monitor monitor{*this, cpu.PC};
+    return cpu.execute(cycle_limit, monitor);
+}
+
+Stop Debugger::step() {
+    Monitor monitor{*this, cpu.PC};
+    return cpu.execute(1, monitor);
+}
+
+namespace {
+bool condition(const Intel8080 &cpu, uint8_t inst) {
+    uint8_t ccc = (inst >> 3) & 0x7;
+    bool flag;
+    switch (ccc >> 1) {
+    case 0:
+        flag = cpu.FLAGS.Z;
+        break;
+    case 1:
+        flag = cpu.FLAGS.C;
+        break;
+    case 2:
+        flag = cpu.FLAGS.P;
+        break;
+    default:
+        flag = cpu.FLAGS.S;
+        break;
+    }
+    return (ccc & 1) ? flag : !flag;
+}
+} // namespace
+
+size_t Debugger::accesses(const Intel8080 &cpu, MemoryAccess (&out)[2]) {
+    const auto &memory = cpu.memory;
+    uint8_t inst = memory[cpu.PC];
+    auto word = [&](Access access, uint16_t address) {
+        out[0] = {address, access};
+        out[1] = {static_cast<uint16_t>(address + 1), access};
+        return 2;
+    };
+    auto byte = [&](uint8_t access, uint16_t address) {
+        out[0] = {address, access};
+        return 1;
+    };
+    uint16_t operand = memory[static_cast<uint16_t>(cpu.PC + 1)] |
+                       memory[static_cast<uint16_t>(cpu.PC + 2)] << 8;
+
+    switch (inst) {
+    case 0x02:
+        return byte(Write, cpu.BC);
+    case 0x12:
+        return byte(Write, cpu.DE);
+    case 0x0a:
+        return byte(Read, cpu.BC);
+    case 0x1a:
+        return byte(Read, cpu.DE);
+    case 0x22:
+        return word(Write, operand);
+    case 0x2a:
+        return word(Read, operand);
+    case 0x32:
+        return byte(Write, operand);
+    case 0x3a:
+        return byte(Read, operand);
+    case 0x34:
+    case 0x35:
+        return byte(Read | Write, cpu.HL);
+    case 0x36:
+        return byte(Write, cpu.HL);
+    case 0x76:
+        return 0;
+    case 0xe3:
+        out[0] = {cpu.SP, Read | Write};
+        out[1] = {static_cast<uint16_t>(cpu.SP + 1), Read | Write};
+        return 2;
+    case 0xc9:
+    case 0xd9:
+        return word(Read, cpu.SP);
+    }
+    if (inst >= 0x40 && inst < 0xc0) {
+        if ((inst & 0xf8) == 0x70) {
+            // MOV M,r
+            return byte(Write, cpu.HL);
+        }
+        return (inst & 0x7) == 6 ? byte(Read, cpu.HL) : 0;
+    }
+    uint16_t stack = cpu.SP - 2;
+    if ((inst & 0xcf) == 0xc1) {
+        // POP
+        return word(Read, cpu.SP);
+    } else if ((inst & 0xcf) == 0xc5 || (inst & 0xcf) == 0xcd ||
+               (inst & 0xc7) == 0xc7) {
+        // PUSH, CALL, RST
+        return word(Write, stack);
+    } else if ((inst & 0xc7) == 0xc4) {
+        // Ccc
+        return condition(cpu, inst) ? word(Write, stack) : 0;
+    } else if ((inst & 0xc7) == 0xc0) {
+        // Rcc
+        return condition(cpu, inst) ? word(Read, cpu.SP) : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+#include "disassembler.h"
+#include "mapped_file.h"
+#include "symbol_map.h"
+
+namespace {
+std::optional<uint16_t> parseAddress(std::string_view text) {
+    uint16_t value;
+    auto end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value, 16);
+    if (ec != std::errc() || ptr != end || text.empty()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::string hexBytes(const std::array<uint8_t, 0x10000> &memory,
+                     uint16_t address, size_t length) {
+    std::ostringstream os;
+    os << std::hex << std::uppercase << std::setfill('0');
+    for (size_t i = 0; i < length; i++) {
+        os << (i == 0 ? "" : " ") << std::setw(2)
+           << +memory[static_cast<uint16_t>(address + i)];
+    }
+    return os.str();
+}
+
+void list(const std::array<uint8_t, 0x10000> &memory, uint16_t low,
+          uint32_t high, const CodeMap &map, const Labels &labels) {
+    for (uint32_t address = low; address < high;) {
+        if (!map.isCode(address)) {
+            // Up to 8 bytes of data per line, stopping at the next code
+            uint32_t end = address;
+            while (end < high && end - address < 8 && !map.isCode(end)) {
+                end++;
+            }
+            std::cout << "        ; " << std::setw(4) << std::setfill('0')
+                      << std::hex << std::uppercase << address << "  DB "
+                      << hexBytes(memory, address, end - address)
+                      << std::endl;
+            address = end;
+            continue;
+        }
+        if (!map.isInstruction(address)) {
+            // Operand bytes that are also jumped into; show them as data
+            std::cout << "        ; " << std::setw(4) << std::setfill('0')
+                      << std::hex << std::uppercase << address << "  DB "
+                      << hexBytes(memory, address, 1) << std::endl;
+            address++;
+            continue;
+        }
+        auto instruction = decode(memory, address);
+        std::string label;
+        if (auto it = labels.find(address); it != labels.end()) {
+            label = it->second + ":";
+        }
+        std::string text = disassemble(instruction, &labels);
+        std::cout << std::left << std::setfill(' ') << std::setw(8) << label
+                  << (label.size() >= 8 ? " " : "") << std::setw(16) << text
+                  << std::right << " ; " << std::setw(4) << std::setfill('0')
+                  << std::hex << std::uppercase << address << "  "
+                  << hexBytes(memory, address, instruction.length())
+                  << std::endl;
+        address += instruction.length();
+    }
+}
+
+void graph(const CodeMap &map, const Labels &labels) {
+    auto name = [&](uint16_t address) {
+        auto it = labels.find(address);
+        std::ostringstream os;
+        os << std::hex << std::setfill('0') << std::setw(4) << address;
+        if (it != labels.end()) {
+            os << "(" << it->second << ")";
+        }
+        return os.str();
+    };
+    for (const auto &block : map.blocks()) {
+        std::cout << name(block.start) << " " << std::dec << std::setw(3)
+                  << std::setfill(' ') << block.instructions << " ->";
+        for (auto successor : block.successors) {
+            std::cout << " " << name(successor);
+        }
+        std::cout << std::endl;
+    }
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name
+              << " [-e ENTRY]... [-m MAP] [-g] FILE[@ORIGIN]..." << std::endl
+              << "  -e ENTRY   hex address to trace code from (default: the "
+                 "first origin)"
+              << std::endl
+              << "  -m MAP     take labels from a symbol map written by "
+                 "bin/asm -m"
+              << std::endl
+              << "  -g         print the basic block graph instead of a "
+                 "listing"
+              << std::endl
+              << "  FILE       an image at its hex origin, by default right "
+                 "after the previous"
+              << std::endl
+              << "             file, e.g. invaders.h@0 invaders.g invaders.f "
+                 "invaders.e"
+              << std::endl;
+    return 2;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<uint16_t> entries;
+    const char *map_path = nullptr;
+    bool print_graph = false;
+    std::vector<std::pair<std::string, std::optional<uint16_t>>> files;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            auto entry = parseAddress(argv[++i]);
+            if (!entry) {
+                return usage(argv[0]);
+            }
+            entries.push_back(*entry);
+        } else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            map_path = argv[++i];
+        } else if (std::strcmp(argv[i], "-g") == 0) {
+            print_graph = true;
+        } else if (argv[i][0] == '-') {
+            return usage(argv[0]);
+        } else {
+            std::string_view arg = argv[i];
+            size_t at = arg.rfind('@');
+            std::optional<uint16_t> origin;
+            if (at != std::string_view::npos) {
+                origin = parseAddress(arg.substr(at + 1));
+                if (!origin) {
+                    return usage(argv[0]);
+                }
+            }
+            files.emplace_back(arg.substr(0, at), origin);
+        }
+    }
+    if (files.empty()) {
+        return usage(argv[0]);
+    }
+
+    auto memory = std::make_unique<std::array<uint8_t, 0x10000>>();
+    memory->fill(0);
+    uint32_t low = 0x10000, high = 0;
+    Labels labels;
+    try {
+        uint32_t next = 0;
+        for (const auto &[path, origin] : files) {
+            MappedFile image(path);
+            uint32_t at = origin.value_or(next);
+            if (at + image.size() > 0x10000) {
+                std::cerr << "'" << path << "' does not fit below 0x10000"
+                          << std::endl;
+                return 1;
+            }
+            std::copy_n(image.data(), image.size(), memory->begin() + at);
+            low = std::min(low, at);
+            high = std::max<uint32_t>(high, at + image.size());
+            next = at + image.size();
+        }
+        if (map_path != nullptr) {
+            auto symbols = SymbolMap::read(map_path);
+            for (const auto &symbol : symbols.labels()) {
+                labels.emplace(symbol.address, symbol.name);
+            }
+        }
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (entries.empty()) {
+        entries.push_back(files.front().second.value_or(0));
+    }
+
+    CodeMap map(*memory, low, high, entries);
+    if (map_path == nullptr) {
+        for (const auto &block : map.blocks()) {
+            if (map.isTarget(block.start)) {
+                std::ostringstream os;
+                os << "L" << std::hex << std::uppercase << std::setfill('0')
+                   << std::setw(4) << block.start;
+                labels.emplace(block.start, os.str());
+            }
+        }
+    }
+
+    size_t code = 0;
+    for (uint32_t address = low; address < high; address++) {
+        code += map.isCode(address);
+    }
+    std::cout << "; " << std::dec << code << " code bytes, "
+              << high - low - code << " data bytes, " << map.blocks().size()
+              << " blocks" << std::endl;
+    if (print_graph) {
+        graph(map, labels);
+    } else {
+        list(*memory, low, high, map, labels);
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "disassembler.h"
+
+namespace {
+// Register and register pair names by code, uppercase
+struct RegisterNames {
+    std::string code[8];
+    std::string pair[4];
+    std::string stack_pair[4];
+
+    RegisterNames() {
+        // The first spelling in the table wins: B, D and H for the pairs
+        for (auto it = std::rbegin(REGISTERS); it != std::rend(REGISTERS);
+             ++it) {
+            std::string name(it->name);
+            for (auto &c : name) {
+                c &= ~0x20;
+            }
+            if (it->code >= 0) {
+                code[it->code] = name;
+            }
+            if (it->pair >= 0) {
+                pair[it->pair] = name;
+            }
+            if (it->stack_pair >= 0) {
+                stack_pair[it->stack_pair] = name;
+            }
+        }
+    }
+};
+
+const RegisterNames &registerNames() {
+    static const RegisterNames names;
+    return names;
+}
+
+std::string upper(std::string_view text) {
+    std::string out(text);
+    for (auto &c : out) {
+        c &= ~0x20;
+    }
+    return out;
+}
+
+// In the assembler's syntax, with a leading 0 if it starts with a letter
+std::string hex(unsigned value, int digits) {
+    char text[8];
+    std::snprintf(text, sizeof(text), "%0*XH", digits, value);
+    return text[0] > '9' ? "0" + std::string(text) : text;
+}
+} // namespace
+
+std::optional<uint16_t> Instruction::target() const {
+    switch (opcode().flow) {
+    case Flow::Jump:
+    case Flow::ConditionalJump:
+    case Flow::Call:
+    case Flow::ConditionalCall:
+        return word();
+    case Flow::Restart:
+        return bytes[0] & 0x38;
+    default:
+        return std::nullopt;
+    }
+}
+
+Instruction decode(const std::array<uint8_t, 0x10000> &memory,
+                   uint16_t address) {
+    return {address,
+            {memory[address], memory[static_cast<uint16_t>(address + 1)],
+             memory[static_cast<uint16_t>(address + 2)]}};
+}
+
+std::string disassemble(const Instruction &instruction, const Labels *labels) {
+    uint8_t op = instruction.bytes[0];
+    std::string text = opcodeName(op);
+    auto word = [&] {
+        if (labels != nullptr) {
+            auto it = labels->find(instruction.word());
+            if (it != labels->end()) {
+                return it->second;
+            }
+        }
+        return hex(instruction.word(), 4);
+    };
+    switch (instruction.opcode().mnemonic->operands) {
+    case Operands::DstByte:
+        return text + "," + hex(instruction.bytes[1], 2);
+    case Operands::Byte:
+        return text + " " + hex(instruction.bytes[1], 2);
+    case Operands::PairWord:
+        return text + "," + word();
+    case Operands::Word:
+        return text + " " + word();
+    default:
+        return text;
+    }
+}
+
+std::string opcodeName(uint8_t op) {
+    const auto &names = registerNames();
+    const auto &opcode = OPCODES[op];
+    std::string text = upper(opcode.mnemonic->name);
+    switch (opcode.mnemonic->operands) {
+    case Operands::Dst:
+    case Operands::DstByte:
+        return text + " " + names.code[(op >> 3) & 7];
+    case Operands::Src:
+        return text + " " + names.code[op & 7];
+    case Operands::DstSrc:
+        return text + " " + names.code[(op >> 3) & 7] + "," +
+               names.code[op & 7];
+    case Operands::Pair:
+    case Operands::PairWord:
+    case Operands::PairBD:
+        return text + " " + names.pair[(op >> 4) & 3];
+    case Operands::PairPSW:
+        return text + " " + names.stack_pair[(op >> 4) & 3];
+    case Operands::Restart:
+        return text + " " + std::to_string((op >> 3) & 7);
+    default:
+        return text;
+    }
+}
+
+CodeMap::CodeMap(const std::array<uint8_t, 0x10000> &memory, uint16_t low,
+                 uint32_t high, const std::vector<uint16_t> &entries) {
+    auto inside = [&](uint32_t address) {
+        return low <= address && address < high;
+    };
+    std::bitset<0x10000> leaders;
+    std::vector<uint16_t> work;
+    for (auto entry : entries) {
+        targets[entry] = true;
+        work.push_back(entry);
+    }
+    while (!work.empty()) {
+        uint32_t address = work.back();
+        work.pop_back();
+        leaders[address] = true;
+        while (inside(address) && !starts[address]) {
+            auto instruction = decode(memory, address);
+            uint32_t next = address + instruction.length();
+            if (next > high) {
+                // Runs off the end of the image
+                break;
+            }
+            starts[address] = true;
+            for (uint32_t i = address; i < next; i++) {
+                code[i] = true;
+            }
+            if (auto target = instruction.target()) {
+                targets[*target] = true;
+                work.push_back(*target);
+            }
+            Flow flow = instruction.opcode().flow;
+            if (flow == Flow::Jump || flow == Flow::Return ||
+                flow == Flow::Indirect || flow == Flow::Halt) {
+                break;
+            }
+            if (flow != Flow::Next && next < 0x10000) {
+                leaders[next] = true;
+            }
+            address = next;
+        }
+    }
+
+    Block *block = nullptr;
+    for (uint32_t address = low; address < high; address++) {
+        if (!starts[address]) {
+            // Data, or the operand bytes of the current instruction
+            if (!code[address]) {
+                block = nullptr;
+            }
+            continue;
+        }
+        if (block == nullptr || leaders[address]) {
+            if (block != nullptr) {
+                block->successors.push_back(address);
+            }
+            block = &list.emplace_back();
+            block->start = address;
+        }
+        auto instruction = decode(memory, address);
+        block->length = instruction.next() - block->start;
+        block->instructions++;
+        block->exit = instruction.opcode().flow;
+        if (block->exit == Flow::Next) {
+            continue;
+        }
+        if (auto target = instruction.target()) {
+            block->successors.push_back(*target);
+        }
+        if (block->exit != Flow::Jump && block->exit != Flow::Return &&
+            block->exit != Flow::Indirect && block->exit != Flow::Halt) {
+            block->successors.push_back(instruction.next());
+        }
+        block = nullptr;
+    }
+}
+
+const CodeMap::Block *CodeMap::blockAt(uint16_t address) const {
+    auto it = std::upper_bound(
+        list.begin(), list.end(), address,
+        [](uint16_t address, const Block &block) {
+            return address < block.start;
+        });
+    if (it == list.begin()) {
+        return nullptr;
+    }
+    const Block &block = *std::prev(it);
+    return address < block.start + block.length ? &block : nullptr;
+}
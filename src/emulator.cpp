@@ -2,7 +2,6 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
-#include <sstream>
 
 #include "emulator.h"
 
@@ -14,33 +13,61 @@ void Intel8080::reset() {
     HL = 0;
     PSW = 2;
     halted = false;
+    halted_at = 0;
     interrupts = true;
+    instructions = 0;
 }
 
-size_t Intel8080::execute(size_t cycle_limit) {
-    size_t cycles = 0;
-    while (!halted && (cycle_limit == 0 || cycles < cycle_limit)) {
-        cycles += instruction(memory[PC++]);
+const char *toString(StopReason reason) {
+    switch (reason) {
+    case StopReason::None:
+        return "none";
+    case StopReason::Halt:
+        return "halt";
+    case StopReason::CycleLimit:
+        return "cycle limit";
+    case StopReason::Breakpoint:
+        return "breakpoint";
+    case StopReason::Watchpoint:
+        return "watchpoint";
+    case StopReason::IllegalOpcode:
+        return "illegal opcode";
+    case StopReason::DeviceTrap:
+        return "device trap";
+    case StopReason::HostRequest:
+        return "host request";
     }
-    return cycles;
+    return "unknown";
 }
 
-size_t Intel8080::debug_execute(size_t cycle_limit) {
-    size_t cycles = 0;
-    while (!halted && (cycle_limit == 0 || cycles < cycle_limit)) {
+Stop Intel8080::execute(size_t cycle_limit) {
+    NoMonitor monitor;
+    return execute(cycle_limit, monitor);
+}
+
+namespace {
+struct DebugMonitor {
+    void step(const Intel8080 &cpu, uint16_t pc, uint8_t inst, size_t) {
         // PC=%%%%(%%) A=%% SZAPC=%%%%% BC=%%%% DE=%%%% HL=%%%%
+        const auto &memory = cpu.memory;
+        uint16_t SP = cpu.SP;
         std::cerr << std::hex << std::setfill('0') << "PC=" << std::setw(4)
-                  << PC << "[" << std::setw(2) << (int)memory[PC] << "]";
-        cycles += instruction(memory[PC++]);
-        std::cerr << " A=" << std::setw(2) << (int)A
-                  << " SZAPC=" << (int)FLAGS.S << (int)FLAGS.Z << (int)FLAGS.A
-                  << (int)FLAGS.P << (int)FLAGS.C << " BC=" << std::setw(4)
-                  << BC << " DE=" << std::setw(4) << DE
-                  << " HL=" << std::setw(4) << HL << " SP=" << std::setw(4)
-                  << SP << "[" << std::setw(2) << (int)memory[SP + 1]
-                  << std::setw(2) << (int)memory[SP] << "]" << std::endl;
+                  << pc << "[" << std::setw(2) << (int)inst << "]";
+        std::cerr << " A=" << std::setw(2) << (int)cpu.A
+                  << " SZAPC=" << (int)cpu.FLAGS.S << (int)cpu.FLAGS.Z
+                  << (int)cpu.FLAGS.A << (int)cpu.FLAGS.P << (int)cpu.FLAGS.C
+                  << " BC=" << std::setw(4) << cpu.BC << " DE=" << std::setw(4)
+                  << cpu.DE << " HL=" << std::setw(4) << cpu.HL
+                  << " SP=" << std::setw(4) << SP << "[" << std::setw(2)
+                  << (int)memory[static_cast<uint16_t>(SP + 1)] << std::setw(2)
+                  << (int)memory[SP] << "]" << std::endl;
     }
-    return cycles;
+};
+} // namespace
+
+Stop Intel8080::debug_execute(size_t cycle_limit) {
+    DebugMonitor monitor;
+    return execute(cycle_limit, monitor);
 }
 
 void Intel8080::interrupt(size_t IQR) {
@@ -70,7 +97,7 @@ size_t Intel8080::instruction(uint8_t inst) {
                 // SHLD
                 uint16_t address = readWord();
                 memory[address] = L;
-                memory[address + 1] = H;
+                memory[static_cast<uint16_t>(address + 1)] = H;
                 return 16;
             } else if (inst == 0x32) {
                 // STA
@@ -145,7 +172,7 @@ size_t Intel8080::instruction(uint8_t inst) {
                 // LHLD
                 uint16_t address = readWord();
                 L = memory[address];
-                H = memory[address + 1];
+                H = memory[static_cast<uint16_t>(address + 1)];
                 return 16;
             } else if (inst == 0x3a) {
                 // LDA
@@ -183,6 +210,7 @@ size_t Intel8080::instruction(uint8_t inst) {
     } else if ((inst & 0xc0) == 0x40) {
         if (inst == 0x76) {
             halted = true;
+            trap = StopReason::Halt;
             return 7;
         }
         register8(dst) = register8(src);
@@ -257,16 +285,16 @@ size_t Intel8080::instruction(uint8_t inst) {
             } else if (inst == 0xd3) {
                 // OUT
                 if (out_callback != nullptr) {
-                    out_callback(readByte(), A);
+                    out_callback(*this, readByte(), A);
                 }
                 return 10;
             } else if (inst == 0xe3) {
                 // XTHL
                 uint16_t tmp = HL;
                 L = memory[SP];
-                H = memory[SP + 1];
+                H = memory[static_cast<uint16_t>(SP + 1)];
                 memory[SP] = tmp;
-                memory[SP + 1] = tmp >> 8;
+                memory[static_cast<uint16_t>(SP + 1)] = tmp >> 8;
                 return 10;
             } else {
                 // DI
@@ -330,7 +358,7 @@ size_t Intel8080::instruction(uint8_t inst) {
             } else if (inst == 0xdb) {
                 // IN
                 if (in_callback != nullptr) {
-                    A = in_callback(readByte());
+                    A = in_callback(*this, readByte());
                 }
                 return 10;
             } else if (inst == 0xeb) {
@@ -359,9 +387,8 @@ size_t Intel8080::instruction(uint8_t inst) {
             return 7;
         }
     }
-    std::ostringstream os;
-    os << "Unimplemented instruction 0x" << std::hex << (int)inst << std::endl;
-    throw std::runtime_error(os.str());
+    trap = StopReason::IllegalOpcode;
+    return 0;
 }
 
 uint8_t Intel8080::add(uint8_t lhs, uint8_t rhs, bool carry) {
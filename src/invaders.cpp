@@ -1,94 +1,45 @@
 #include <SDL.h>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
-#include "emulator.h"
-#include "invaders.h"
-
-struct Input {
-    union {
-        struct {
-            uint8_t credit : 1;
-            uint8_t start2 : 1;
-            uint8_t start1 : 1;
-            uint8_t : 1;
-            uint8_t shot1 : 1;
-            uint8_t left1 : 1;
-            uint8_t right1 : 1;
-            uint8_t : 1;
-        };
-        uint8_t value;
-    } port1;
-
-    union {
-        struct {
-            uint8_t dip3 : 1;
-            uint8_t dip5 : 1;
-            uint8_t tilt : 1;
-            uint8_t dip6 : 1;
-            uint8_t shot2 : 1;
-            uint8_t left2 : 1;
-            uint8_t right3 : 1;
-            uint8_t dip7 : 1;
-        };
-        uint8_t value;
-    } port2;
-} input;
-
-struct ShiftRegister {
-    uint16_t data;
-    uint8_t offset;
-} sr;
-
-uint8_t in_callback(uint8_t port) {
-    switch (port) {
-    case 1:
-        return input.port1.value;
-    case 2:
-        return input.port2.value;
-    case 3:
-        return sr.data >> sr.offset;
-    }
-    throw std::runtime_error("Invalid port read");
-}
-
-void out_callback(uint8_t port, uint8_t A) {
-    switch (port) {
-    case 2:
-        sr.offset = A & 0x7;
-        return;
-    case 4:
-        sr.data = (sr.data << 8) | A;
-        return;
-    case 3:
-    case 5:
-    case 6:
-        return; // not implemented
+#include "capture.h"
+#include "loader.h"
+#include "space_invaders.h"
+
+int main(int argc, char **argv) {
+    std::filesystem::path roms = "roms";
+    std::string set = "invaders";
+    std::filesystem::path capture_path;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            roms = argv[++i];
+        } else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            set = argv[++i];
+        } else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [-r ROM_DIR] [-s SET] [-c CAPTURE]" << std::endl;
+            return 2;
+        }
     }
-    throw std::runtime_error("Invalid port write");
-}
 
-int main() {
-    Intel8080 i8080;
-    i8080.in_callback = in_callback;
-    i8080.out_callback = out_callback;
-
-    auto loadRom = [&i8080](unsigned char *rom, unsigned int len,
-                            unsigned off) {
-        for (unsigned i = 0; i < len; i++) {
-            i8080.memory[i + off] = rom[i];
+    auto invaders = std::make_unique<SpaceInvaders>();
+    std::unique_ptr<Capture> capture;
+    try {
+        Manifest manifest(roms / "MANIFEST");
+        loadSet(manifest, set, roms, invaders->memory);
+        if (!capture_path.empty()) {
+            capture = std::make_unique<Capture>(
+                capture_path, Capture::formatFor(capture_path));
         }
-    };
-
-    loadRom(roms_invaders_h, roms_invaders_h_len, 0x0000);
-    loadRom(roms_invaders_g, roms_invaders_g_len, 0x0800);
-    loadRom(roms_invaders_f, roms_invaders_f_len, 0x1000);
-    loadRom(roms_invaders_e, roms_invaders_e_len, 0x1800);
-
-    input.port2.dip3 = 0;
-    input.port2.dip5 = 0;
-    input.port2.dip6 = 0;
-    input.port2.dip7 = 1;
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -117,38 +68,38 @@ int main() {
             case SDL_KEYDOWN:
                 switch (event.key.keysym.sym) {
                 case SDLK_c:
-                    input.port1.credit = 1;
+                    invaders->input.port1.credit = 1;
                     break;
                 case SDLK_RETURN:
-                    input.port1.start1 = 1;
+                    invaders->input.port1.start1 = 1;
                     break;
                 case SDLK_SPACE:
-                    input.port1.shot1 = 1;
+                    invaders->input.port1.shot1 = 1;
                     break;
                 case SDLK_LEFT:
-                    input.port1.left1 = 1;
+                    invaders->input.port1.left1 = 1;
                     break;
                 case SDLK_RIGHT:
-                    input.port1.right1 = 1;
+                    invaders->input.port1.right1 = 1;
                     break;
                 }
                 break;
             case SDL_KEYUP:
                 switch (event.key.keysym.sym) {
                 case SDLK_c:
-                    input.port1.credit = 0;
+                    invaders->input.port1.credit = 0;
                     break;
                 case SDLK_RETURN:
-                    input.port1.start1 = 0;
+                    invaders->input.port1.start1 = 0;
                     break;
                 case SDLK_SPACE:
-                    input.port1.shot1 = 0;
+                    invaders->input.port1.shot1 = 0;
                     break;
                 case SDLK_LEFT:
-                    input.port1.left1 = 0;
+                    invaders->input.port1.left1 = 0;
                     break;
                 case SDLK_RIGHT:
-                    input.port1.right1 = 0;
+                    invaders->input.port1.right1 = 0;
                     break;
                 }
                 break;
@@ -158,9 +109,20 @@ int main() {
             }
         }
 
-        if (i8080.halted) {
+        auto stop = invaders->frame();
+        if (stop.reason != StopReason::CycleLimit) {
+            std::cerr << "Stopped at " << std::hex << stop.PC << ": "
+                      << toString(stop.reason) << std::endl;
             running = false;
-            break;
+        }
+        if (capture != nullptr) {
+            try {
+                capture->add(invaders->vram());
+            } catch (std::runtime_error &e) {
+                // Keep playing without recording
+                std::cerr << e.what() << std::endl;
+                capture.reset();
+            }
         }
 
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
@@ -168,18 +130,14 @@ int main() {
 
         SDL_Point points[WW * WH];
         int count = 0;
-
-        for (int i = 0; i < 2; i++) {
-            i8080.interrupt(i + 1);
-            i8080.execute(2000000 / 120);
-            for (int x = (i == 0 ? 0 : 112); x < (i == 0 ? 112 : WH); x++) {
-                for (int y = 0; y < WW; y++) {
-                    int index = (x * WH + y) / 8, offset = (x * WH + y) % 8;
-                    if ((i8080.memory[0x2400 + index] >> offset) & 0x1) {
-                        points[count].x = x;
-                        points[count].y = WW - y;
-                        ++count;
-                    }
+        const uint8_t *vram = invaders->vram();
+        for (int x = 0; x < WH; x++) {
+            for (int y = 0; y < WW; y++) {
+                int index = (x * WH + y) / 8, offset = (x * WH + y) % 8;
+                if ((vram[index] >> offset) & 0x1) {
+                    points[count].x = x;
+                    points[count].y = WW - y;
+                    ++count;
                 }
             }
         }
@@ -195,6 +153,14 @@ int main() {
         }
     }
 
+    if (capture != nullptr) {
+        try {
+            capture->close();
+        } catch (std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "invaders_batch.h"
+
+namespace {
+// Player 1 score, four BCD digits low byte first
+constexpr uint16_t SCORE = 0x20f8;
+
+uint32_t bcd(uint8_t value) { return (value >> 4) * 10 + (value & 0xf); }
+} // namespace
+
+InvadersBatch::InvadersBatch(size_t count, const uint8_t *rom, size_t length,
+                             Observation observation, unsigned threads)
+    : rom(rom, rom + std::min<size_t>(length, SpaceInvaders::VRAM)),
+      observation(observation),
+      observation_size(observation == Observation::Packed
+                           ? SpaceInvaders::VRAM_SIZE
+                           : WIDTH * HEIGHT),
+      machines(count), frames(count * observation_size), score(count),
+      stop(count, StopReason::CycleLimit) {
+    reset();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<size_t>(threads, count);
+    for (unsigned t = 1; t < threads; t++) {
+        workers.emplace_back([this] { work(); });
+    }
+}
+
+InvadersBatch::~InvadersBatch() {
+    {
+        std::lock_guard lock(mutex);
+        quit = true;
+    }
+    start.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void InvadersBatch::reset() {
+    for (size_t i = 0; i < machines.size(); i++) {
+        machines[i] = std::make_unique<SpaceInvaders>();
+        std::copy(rom.begin(), rom.end(), machines[i]->memory.begin());
+        observe(i);
+    }
+    std::fill(stop.begin(), stop.end(), StopReason::CycleLimit);
+}
+
+void InvadersBatch::step(const uint8_t *actions) {
+    this->actions = actions;
+    next = 0;
+    {
+        std::lock_guard lock(mutex);
+        generation++;
+        pending = workers.size();
+    }
+    start.notify_all();
+    share();
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+}
+
+void InvadersBatch::work() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            start.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) {
+                return;
+            }
+            seen = generation;
+        }
+        share();
+        std::lock_guard lock(mutex);
+        if (--pending == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+void InvadersBatch::share() {
+    for (size_t i = next++; i < machines.size(); i = next++) {
+        stepMachine(i);
+    }
+}
+
+void InvadersBatch::stepMachine(size_t i) {
+    auto &machine = *machines[i];
+    uint8_t action = actions[i];
+    auto &port1 = machine.input.port1;
+    port1.left1 = (action & Left) != 0;
+    port1.right1 = (action & Right) != 0;
+    port1.shot1 = (action & Fire) != 0;
+    port1.credit = (action & Coin) != 0;
+    port1.start1 = (action & Start) != 0;
+    stop[i] = machine.frame().reason;
+    observe(i);
+}
+
+void InvadersBatch::observe(size_t i) {
+    const auto &machine = *machines[i];
+    const uint8_t *vram = machine.vram();
+    uint8_t *out = frames.data() + i * observation_size;
+    score[i] = bcd(machine.memory[SCORE + 1]) * 100 +
+               bcd(machine.memory[SCORE]);
+
+    if (observation == Observation::Packed) {
+        std::memcpy(out, vram, SpaceInvaders::VRAM_SIZE);
+        return;
+    }
+    std::memset(out, 0, observation_size);
+    for (size_t x = 0; x < 224; x++) {
+        const uint8_t *column = vram + x * 32;
+        for (size_t k = 0; k < 32; k++) {
+            for (uint8_t bits = column[k]; bits != 0; bits &= bits - 1) {
+                // Bit b of a column is b pixels up from the bottom
+                size_t b = k * 8 + std::countr_zero(bits);
+                out[(HEIGHT - 1 - b / 2) * WIDTH + x / 2] = 0xff;
+            }
+        }
+    }
+}
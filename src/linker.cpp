@@ -0,0 +1,78 @@
+#include <algorithm>
+
+#include "linker.h"
+
+void Linker::add(std::string name, const Object &object,
+                 std::optional<uint16_t> origin) {
+    uint32_t at = 0;
+    if (origin.has_value()) {
+        at = *origin;
+    } else if (!sections.empty()) {
+        at = sections.back().origin + sections.back().object->code.size();
+    }
+    sections.push_back({std::move(name), &object, at});
+}
+
+std::vector<uint8_t> Linker::link() {
+    if (sections.empty()) {
+        return {};
+    }
+
+    auto order = sections;
+    std::sort(order.begin(), order.end(), [](const auto &a, const auto &b) {
+        return a.origin < b.origin;
+    });
+    for (size_t i = 0; i < order.size(); i++) {
+        uint32_t end = order[i].origin + order[i].object->code.size();
+        if (end > 0x10000) {
+            reported.push_back(order[i].name + " ends past 0xffff");
+        } else if (i + 1 < order.size() && end > order[i + 1].origin) {
+            reported.push_back(order[i].name + " overlaps " +
+                               order[i + 1].name);
+        }
+    }
+    if (hadErrors()) {
+        return {};
+    }
+
+    std::unordered_map<std::string, const Section *> definitions;
+    for (const auto &section : sections) {
+        for (const auto &symbol : section.object->symbols) {
+            if (!symbol.defined || symbol.local) {
+                continue;
+            }
+            auto [it, inserted] = definitions.emplace(symbol.name, &section);
+            if (!inserted) {
+                reported.push_back("'" + symbol.name + "' is defined in " +
+                                   it->second->name + " and " + section.name);
+                continue;
+            }
+            addresses[symbol.name] = section.origin + symbol.offset;
+        }
+    }
+
+    lowest = order.front().origin;
+    uint32_t highest = order.back().origin + order.back().object->code.size();
+    std::vector<uint8_t> image(highest - lowest);
+    for (const auto &section : sections) {
+        const auto &object = *section.object;
+        uint8_t *out = image.data() + section.origin - lowest;
+        std::copy(object.code.begin(), object.code.end(), out);
+        for (const auto &relocation : object.relocations) {
+            const auto &symbol = object.symbols[relocation.symbol];
+            uint16_t address = section.origin + symbol.offset;
+            if (!symbol.local) {
+                auto it = addresses.find(symbol.name);
+                if (it == addresses.end()) {
+                    reported.push_back(section.name + ": undefined symbol '" +
+                                       symbol.name + "'");
+                    continue;
+                }
+                address = it->second;
+            }
+            out[relocation.offset] = address & 0xff;
+            out[relocation.offset + 1] = address >> 8;
+        }
+    }
+    return image;
+}
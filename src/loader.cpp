@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "loader.h"
+
+namespace {
+constexpr std::array<uint32_t, 0x100> CRC_TABLE = [] {
+    std::array<uint32_t, 0x100> table{};
+    for (uint32_t i = 0; i < table.size(); i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}();
+
+void sha1Block(std::array<uint32_t, 5> &h, const uint8_t *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = block[i * 4] << 24 | block[i * 4 + 1] << 16 |
+               block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = std::rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+} // namespace
+
+uint32_t crc32(const uint8_t *data, size_t length) {
+    uint32_t c = 0xffffffff;
+    for (size_t i = 0; i < length; i++) {
+        c = CRC_TABLE[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    }
+    return ~c;
+}
+
+std::string sha1(const uint8_t *data, size_t length) {
+    std::array<uint32_t, 5> h = {0x67452301, 0xefcdab89, 0x98badcfe,
+                                 0x10325476, 0xc3d2e1f0};
+    size_t whole = length / 64 * 64;
+    for (size_t i = 0; i < whole; i += 64) {
+        sha1Block(h, data + i);
+    }
+    // Final block(s): remaining bytes, 0x80, zeros and the bit length
+    uint8_t tail[128] = {};
+    size_t rest = length - whole;
+    std::memcpy(tail, data + whole, rest);
+    tail[rest] = 0x80;
+    size_t tail_length = rest < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(length) * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_length - 1 - i] = bits >> (i * 8);
+    }
+    for (size_t i = 0; i < tail_length; i += 64) {
+        sha1Block(h, tail + i);
+    }
+
+    std::ostringstream os;
+    os << std::hex << std::setfill('0');
+    for (auto word : h) {
+        os << std::setw(8) << word;
+    }
+    return os.str();
+}
+
+Manifest::Manifest(const std::filesystem::path &path) {
+    std::ifstream is(path);
+    if (!is) {
+        throw std::runtime_error("could not open manifest '" + path.string() +
+                                 "'");
+    }
+    std::string line;
+    for (int number = 1; std::getline(is, line); number++) {
+        std::istringstream fields(line);
+        Entry entry;
+        unsigned address;
+        if (!(fields >> entry.set) || entry.set[0] == '#') {
+            continue;
+        }
+        if (!(fields >> entry.file >> std::hex >> address >> entry.crc32 >>
+              entry.sha1) ||
+            address > 0xffff) {
+            throw std::runtime_error(path.string() + ":" +
+                                     std::to_string(number) +
+                                     ": malformed manifest entry");
+        }
+        entry.address = address;
+        entries.push_back(entry);
+    }
+}
+
+std::vector<Manifest::Entry> Manifest::set(const std::string &name) const {
+    std::vector<Entry> result;
+    std::copy_if(entries.begin(), entries.end(), std::back_inserter(result),
+                 [&name](const Entry &entry) { return entry.set == name; });
+    return result;
+}
+
+const Manifest::Entry *Manifest::find(const std::string &file) const {
+    auto it = std::find_if(
+        entries.begin(), entries.end(),
+        [&file](const Entry &entry) { return entry.file == file; });
+    return it == entries.end() ? nullptr : &*it;
+}
+
+void verify(const Manifest::Entry &entry, const MappedFile &image) {
+    std::ostringstream os;
+    uint32_t crc = crc32(image.data(), image.size());
+    if (crc != entry.crc32) {
+        os << entry.file << ": CRC32 is " << std::hex << std::setfill('0')
+           << std::setw(8) << crc << ", expected " << std::setw(8)
+           << entry.crc32;
+        throw std::runtime_error(os.str());
+    }
+    if (entry.sha1 != "-") {
+        auto digest = sha1(image.data(), image.size());
+        if (digest != entry.sha1) {
+            throw std::runtime_error(entry.file + ": SHA-1 is " + digest +
+                                     ", expected " + entry.sha1);
+        }
+    }
+}
+
+void loadSet(const Manifest &manifest, const std::string &set,
+             const std::filesystem::path &dir,
+             std::array<uint8_t, 0x10000> &memory) {
+    auto entries = manifest.set(set);
+    if (entries.empty()) {
+        throw std::runtime_error("unknown ROM set '" + set + "'");
+    }
+    for (const auto &entry : entries) {
+        MappedFile image(dir / entry.file);
+        verify(entry, image);
+        if (image.size() > memory.size() - entry.address) {
+            throw std::runtime_error(entry.file +
+                                     " does not fit in the address space");
+        }
+        std::memcpy(memory.data() + entry.address, image.data(),
+                    image.size());
+    }
+}
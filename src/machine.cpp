@@ -0,0 +1,53 @@
+#include <algorithm>
+
+#include "machine.h"
+
+Machine::Machine() {
+    in_callback = portRead;
+    out_callback = portWrite;
+}
+
+void Machine::attach(Device device) {
+    devices.push_back(std::move(device));
+    devices.back().handle.resume();
+}
+
+void Machine::schedule(Timer *timer) {
+    // Keep the queue sorted by deadline, first come first served on ties
+    Timer **link = &timers;
+    while (*link != nullptr && (*link)->deadline <= timer->deadline) {
+        link = &(*link)->next;
+    }
+    timer->next = *link;
+    *link = timer;
+}
+
+Stop Machine::run(uint64_t cycles) {
+    NoMonitor monitor;
+    return run(cycles, monitor);
+}
+
+uint8_t Machine::portRead(Intel8080 &cpu, uint8_t port) {
+    auto &machine = static_cast<Machine &>(cpu);
+    if (!machine.readable[port]) {
+        machine.raise(StopReason::DeviceTrap);
+    }
+    return machine.inputs[port];
+}
+
+void Machine::portWrite(Intel8080 &cpu, uint8_t port, uint8_t value) {
+    auto &machine = static_cast<Machine &>(cpu);
+    if (!machine.writable[port]) {
+        machine.raise(StopReason::DeviceTrap);
+        return;
+    }
+    // Detach the waiters first, they may wait on the same port again
+    PortWrite *waiter = machine.writers[port];
+    machine.writers[port] = nullptr;
+    while (waiter != nullptr) {
+        PortWrite *next = waiter->next;
+        waiter->value = value;
+        waiter->handle.resume();
+        waiter = next;
+    }
+}
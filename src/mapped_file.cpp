@@ -0,0 +1,41 @@
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open '" + path.string() + "'");
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat '" + path.string() + "'");
+    }
+    length = st.st_size;
+    if (length > 0) {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map '" + path.string() + "'");
+        }
+        bytes = static_cast<const uint8_t *>(mapping);
+    }
+    close(fd);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : bytes(other.bytes), length(other.length) {
+    other.bytes = nullptr;
+    other.length = 0;
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        munmap(const_cast<uint8_t *>(bytes), length);
+    }
+}
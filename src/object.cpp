@@ -0,0 +1,119 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "object.h"
+
+namespace {
+constexpr char MAGIC[4] = {'O', '8', '0', 0x01};
+
+void put16(std::string &out, uint16_t value) {
+    out.push_back(value & 0xff);
+    out.push_back(value >> 8);
+}
+
+class Reader {
+  public:
+    Reader(const uint8_t *data, size_t size, const std::string &name)
+        : data(data), size(size), name(name) {}
+
+    const uint8_t *take(size_t length) {
+        if (size - position < length) {
+            throw std::runtime_error("'" + name + "' is truncated");
+        }
+        position += length;
+        return data + position - length;
+    }
+    bool done() const { return position == size; }
+    uint8_t get8() { return *take(1); }
+    uint16_t get16() {
+        const uint8_t *bytes = take(2);
+        return bytes[0] | bytes[1] << 8;
+    }
+
+  private:
+    const uint8_t *data;
+    size_t size;
+    size_t position = 0;
+    const std::string &name;
+};
+} // namespace
+
+void Object::serialize(std::string &out) const {
+    if (code.size() > 0xffff || symbols.size() > 0xffff ||
+        relocations.size() > 0xffff) {
+        throw std::runtime_error("object is too large");
+    }
+    out.append(MAGIC, sizeof(MAGIC));
+    put16(out, code.size());
+    put16(out, symbols.size());
+    put16(out, relocations.size());
+    out.append(code.begin(), code.end());
+    for (const auto &symbol : symbols) {
+        if (symbol.name.size() > 0xff) {
+            throw std::runtime_error("symbol name '" + symbol.name +
+                                     "' is too long");
+        }
+        put16(out, symbol.offset);
+        out.push_back(symbol.defined | symbol.local << 1);
+        out.push_back(symbol.name.size());
+        out += symbol.name;
+    }
+    for (const auto &relocation : relocations) {
+        put16(out, relocation.offset);
+        put16(out, relocation.symbol);
+    }
+}
+
+Object Object::parse(const uint8_t *data, size_t size,
+                     const std::string &name) {
+    Reader reader(data, size, name);
+    if (std::memcmp(reader.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("'" + name + "' is not an object file");
+    }
+    Object object;
+    uint16_t code_size = reader.get16();
+    object.symbols.resize(reader.get16());
+    object.relocations.resize(reader.get16());
+    const uint8_t *code = reader.take(code_size);
+    object.code.assign(code, code + code_size);
+    for (auto &symbol : object.symbols) {
+        symbol.offset = reader.get16();
+        uint8_t flags = reader.get8();
+        symbol.defined = (flags & 1) != 0;
+        symbol.local = (flags & 2) != 0;
+        uint8_t length = reader.get8();
+        symbol.name.assign(reinterpret_cast<const char *>(reader.take(length)),
+                           length);
+        if (flags > 3 || (symbol.local && !symbol.defined)) {
+            throw std::runtime_error("'" + name + "' has a bad symbol");
+        }
+    }
+    for (auto &relocation : object.relocations) {
+        relocation.offset = reader.get16();
+        relocation.symbol = reader.get16();
+        if (relocation.symbol >= object.symbols.size() ||
+            relocation.offset + 2u > object.code.size()) {
+            throw std::runtime_error("'" + name + "' has a bad relocation");
+        }
+    }
+    if (!reader.done()) {
+        throw std::runtime_error("'" + name + "' has trailing bytes");
+    }
+    return object;
+}
+
+void Object::write(const std::filesystem::path &path) const {
+    std::string out;
+    serialize(out);
+    std::ofstream os(path, std::ios::binary);
+    if (!os.write(out.data(), out.size())) {
+        throw std::runtime_error("could not write '" + path.string() + "'");
+    }
+}
+
+Object Object::read(const std::filesystem::path &path) {
+    MappedFile file(path);
+    return parse(file.data(), file.size(), path.string());
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <numeric>
+
+#include "disassembler.h"
+#include "profiler.h"
+
+Profiler::Profiler()
+    : pc_count(0x10000), pc_cycles(0x10000), routines(0x10000) {
+    stack.reserve(MAX_DEPTH);
+}
+
+void Profiler::enter(uint16_t entry) {
+    if (!stack.empty()) {
+        edges[(stack.back().entry << 16) | entry]++;
+    }
+    if (stack.size() == MAX_DEPTH) {
+        // The guest is not returning through RET; forget the oldest frame
+        stack.erase(stack.begin());
+    }
+    routines[entry].calls++;
+    stack.push_back({entry, total_cycles});
+}
+
+void Profiler::leave() {
+    auto frame = stack.back();
+    stack.pop_back();
+    routines[frame.entry].inclusive += total_cycles - frame.start;
+}
+
+namespace {
+// Indices of the `top` largest elements of `values`, largest first.
+template <typename T, typename Key>
+std::vector<size_t> topIndices(const T &values, size_t top, Key key) {
+    std::vector<size_t> indices(values.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    indices.erase(std::remove_if(indices.begin(), indices.end(),
+                                 [&](size_t i) { return key(i) == 0; }),
+                  indices.end());
+    top = std::min(top, indices.size());
+    std::partial_sort(indices.begin(), indices.begin() + top, indices.end(),
+                      [&](size_t a, size_t b) { return key(a) > key(b); });
+    indices.resize(top);
+    return indices;
+}
+
+double percent(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0 : 100.0 * part / whole;
+}
+
+struct Total {
+    uint64_t count = 0;
+    uint64_t cycles = 0;
+};
+
+// The `top` totals with the most cycles, as "  count  cycles  %  name" rows
+void reportTotals(std::ostream &os, const std::map<std::string, Total> &totals,
+                  size_t top, uint64_t total_cycles) {
+    std::vector<std::pair<std::string, Total>> sorted(totals.begin(),
+                                                      totals.end());
+    top = std::min(top, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + top, sorted.end(),
+                      [](const auto &a, const auto &b) {
+                          return a.second.cycles > b.second.cycles;
+                      });
+    sorted.resize(top);
+    for (const auto &[name, total] : sorted) {
+        os << std::setw(11) << total.count << std::setw(13) << total.cycles
+           << std::fixed << std::setprecision(2) << std::setw(7)
+           << percent(total.cycles, total_cycles) << "  " << name
+           << std::endl;
+    }
+}
+} // namespace
+
+void Profiler::report(std::ostream &os, size_t top,
+                      const SymbolMap *symbols) const {
+    auto where = [symbols](uint16_t address) {
+        return symbols == nullptr ? std::string()
+                                  : "  " + symbols->describe(address);
+    };
+    auto flags = os.flags();
+    os << std::dec << total_instructions << " instructions, " << total_cycles
+       << " cycles" << std::endl;
+
+    os << std::endl << "Hot spots" << std::endl;
+    os << "  PC      count       cycles      %" << (symbols ? "  WHERE" : "")
+       << std::endl;
+    for (auto pc : topIndices(pc_cycles, top,
+                              [this](size_t i) { return pc_cycles[i]; })) {
+        os << "  " << std::hex << std::setfill('0') << std::setw(4) << pc
+           << std::dec << std::setfill(' ') << std::setw(11) << pc_count[pc]
+           << std::setw(13) << pc_cycles[pc] << std::fixed
+           << std::setprecision(2) << std::setw(7)
+           << percent(pc_cycles[pc], total_cycles) << where(pc) << std::endl;
+    }
+
+    if (symbols != nullptr) {
+        std::map<std::string, Total> labels;
+        std::map<std::string, Total> lines;
+        for (size_t pc = 0; pc < pc_cycles.size(); pc++) {
+            if (pc_count[pc] == 0) {
+                continue;
+            }
+            const auto *symbol = symbols->symbolAt(pc);
+            auto &label = labels[symbol ? symbol->name : "(no label)"];
+            label.count += pc_count[pc];
+            label.cycles += pc_cycles[pc];
+            if (const auto *line = symbols->lineAt(pc)) {
+                auto &total = lines[symbols->fileName(*line) + ":" +
+                                    std::to_string(line->number)];
+                total.count += pc_count[pc];
+                total.cycles += pc_cycles[pc];
+            }
+        }
+        os << std::endl << "Labels" << std::endl;
+        os << "      count       cycles      %  LABEL" << std::endl;
+        reportTotals(os, labels, top, total_cycles);
+        os << std::endl << "Source lines" << std::endl;
+        os << "      count       cycles      %  LINE" << std::endl;
+        reportTotals(os, lines, top, total_cycles);
+    }
+
+    os << std::endl << "Instruction mix" << std::endl;
+    os << "  OP      count       %       cycles  INSTRUCTION" << std::endl;
+    for (auto inst :
+         topIndices(opcode_count, opcode_count.size(),
+                    [this](size_t i) { return opcode_count[i]; })) {
+        os << "  " << std::hex << std::setfill('0') << std::setw(2) << inst
+           << std::dec << std::setfill(' ') << std::setw(13)
+           << opcode_count[inst] << std::fixed << std::setprecision(2)
+           << std::setw(7) << percent(opcode_count[inst], total_instructions)
+           << std::setw(13) << opcode_cycles[inst] << "  "
+           << opcodeName(inst) << std::endl;
+    }
+
+    os << std::endl << "Routines" << std::endl;
+    os << "  ENTRY   calls         self      %    inclusive"
+       << (symbols ? "  WHERE" : "") << std::endl;
+    for (auto entry : topIndices(routines, top, [this](size_t i) {
+             return routines[i].self;
+         })) {
+        const auto &routine = routines[entry];
+        os << "  " << std::hex << std::setfill('0') << std::setw(4) << entry
+           << std::dec << std::setfill(' ') << std::setw(11) << routine.calls
+           << std::setw(13) << routine.self << std::fixed
+           << std::setprecision(2) << std::setw(7)
+           << percent(routine.self, total_cycles) << std::setw(13)
+           << routine.inclusive << where(entry) << std::endl;
+    }
+
+    std::vector<std::pair<uint32_t, uint64_t>> sorted(edges.begin(),
+                                                      edges.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](auto a, auto b) { return a.second > b.second; });
+    sorted.resize(std::min(top, sorted.size()));
+    os << std::endl << "Call graph" << std::endl;
+    os << "  CALLER -> CALLEE       count" << (symbols ? "  WHERE" : "")
+       << std::endl;
+    for (auto [edge, count] : sorted) {
+        os << "  " << std::hex << std::setfill('0') << std::setw(4)
+           << (edge >> 16) << "   -> " << std::setw(4) << (edge & 0xffff)
+           << std::dec << std::setfill(' ') << std::setw(16) << count;
+        if (symbols != nullptr) {
+            os << "  " << symbols->describe(edge >> 16) << " -> "
+               << symbols->describe(edge & 0xffff);
+        }
+        os << std::endl;
+    }
+    os.flags(flags);
+}
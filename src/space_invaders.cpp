@@ -0,0 +1,69 @@
+#include <cstring>
+
+#include "space_invaders.h"
+
+SpaceInvaders::SpaceInvaders() {
+    memory.fill(0);
+    input.port2.dip7 = 1;
+    mapInput(1);
+    mapInput(2);
+    mapInput(3);
+    for (uint8_t port : {2, 3, 4, 5, 6}) {
+        mapOutput(port);
+    }
+    attach(shiftOffset());
+    attach(shiftData());
+    attach(soundLatch(3, sound[0]));
+    attach(soundLatch(5, sound[1]));
+    attach(video());
+}
+
+uint64_t SpaceInvaders::startFrame() {
+    inputs[1] = input.port1.value;
+    inputs[2] = input.port2.value;
+    frame_end += 2 * HALF_FRAME;
+    return frame_end > now ? frame_end - now : 0;
+}
+
+uint64_t SpaceInvaders::vramHash() const {
+    // Multiply-xorshift over 64-bit words
+    uint64_t h = 0x9e3779b97f4a7c15 ^ VRAM_SIZE;
+    for (size_t i = 0; i < VRAM_SIZE; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, vram() + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccd;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+Device SpaceInvaders::shiftOffset() {
+    while (true) {
+        shift_offset = co_await written(2) & 0x7;
+        inputs[3] = shift_data >> (8 - shift_offset);
+    }
+}
+
+Device SpaceInvaders::shiftData() {
+    while (true) {
+        shift_data = (shift_data >> 8) | (co_await written(4) << 8);
+        inputs[3] = shift_data >> (8 - shift_offset);
+    }
+}
+
+Device SpaceInvaders::soundLatch(uint8_t port, uint8_t &latch) {
+    while (true) {
+        latch = co_await written(port);
+    }
+}
+
+Device SpaceInvaders::video() {
+    co_await elapsed(0);
+    while (true) {
+        interrupt(1);
+        co_await elapsed(HALF_FRAME);
+        interrupt(2);
+        co_await elapsed(HALF_FRAME);
+        frames++;
+    }
+}
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "symbol_map.h"
+
+namespace {
+constexpr char MAGIC[4] = {'M', '8', '0', 0x01};
+constexpr size_t LINE_SIZE = 9;
+
+void put16(std::string &out, uint16_t value) {
+    out.push_back(value & 0xff);
+    out.push_back(value >> 8);
+}
+
+void put32(std::string &out, uint32_t value) {
+    put16(out, value & 0xffff);
+    put16(out, value >> 16);
+}
+
+class Reader {
+  public:
+    Reader(const uint8_t *data, size_t size, const std::string &name)
+        : data(data), size(size), name(name) {}
+
+    const uint8_t *take(size_t length) {
+        if (size - position < length) {
+            throw std::runtime_error("'" + name + "' is truncated");
+        }
+        position += length;
+        return data + position - length;
+    }
+    size_t remaining() const { return size - position; }
+    uint8_t get8() { return *take(1); }
+    uint16_t get16() {
+        const uint8_t *bytes = take(2);
+        return bytes[0] | bytes[1] << 8;
+    }
+    uint32_t get32() {
+        uint32_t low = get16();
+        return low | uint32_t(get16()) << 16;
+    }
+    std::string getString(size_t length) {
+        return {reinterpret_cast<const char *>(take(length)), length};
+    }
+
+  private:
+    const uint8_t *data;
+    size_t size;
+    size_t position = 0;
+    const std::string &name;
+};
+} // namespace
+
+uint16_t SymbolMap::addFile(std::string name) {
+    if (files.size() == 0xffff) {
+        throw std::runtime_error("too many files for a symbol map");
+    }
+    files.push_back(std::move(name));
+    return files.size() - 1;
+}
+
+void SymbolMap::addSymbol(std::string name, uint16_t address) {
+    symbols.push_back({address, std::move(name)});
+}
+
+void SymbolMap::addLine(uint16_t file, uint32_t number, uint16_t address,
+                        uint8_t size) {
+    lines.push_back({address, size, file, number});
+}
+
+void SymbolMap::sort() {
+    std::stable_sort(
+        symbols.begin(), symbols.end(),
+        [](const auto &a, const auto &b) { return a.address < b.address; });
+    std::stable_sort(
+        lines.begin(), lines.end(),
+        [](const auto &a, const auto &b) { return a.address < b.address; });
+}
+
+const SymbolMap::Symbol *SymbolMap::symbolAt(uint16_t address) const {
+    // A label covers the code after it, not whatever lies past the program
+    if (!lines.empty() && lineAt(address) == nullptr) {
+        return nullptr;
+    }
+    auto it = std::upper_bound(
+        symbols.begin(), symbols.end(), address,
+        [](uint16_t address, const auto &symbol) {
+            return address < symbol.address;
+        });
+    return it == symbols.begin() ? nullptr : &*std::prev(it);
+}
+
+const SymbolMap::Line *SymbolMap::lineAt(uint16_t address) const {
+    auto it = std::upper_bound(
+        lines.begin(), lines.end(), address,
+        [](uint16_t address, const auto &line) {
+            return address < line.address;
+        });
+    if (it == lines.begin()) {
+        return nullptr;
+    }
+    const Line &line = *std::prev(it);
+    return address < line.address + line.size ? &line : nullptr;
+}
+
+std::string SymbolMap::describe(uint16_t address) const {
+    std::ostringstream os;
+    if (const Symbol *symbol = symbolAt(address)) {
+        os << symbol->name;
+        if (address != symbol->address) {
+            os << "+" << std::hex << address - symbol->address << std::dec;
+        }
+    }
+    if (const Line *line = lineAt(address)) {
+        if (os.tellp() > 0) {
+            os << " ";
+        }
+        os << fileName(*line) << ":" << line->number;
+    }
+    return os.str();
+}
+
+void SymbolMap::write(const std::filesystem::path &path) const {
+    if (symbols.size() > 0xffff) {
+        throw std::runtime_error("too many symbols for a symbol map");
+    }
+    std::string out(MAGIC, sizeof(MAGIC));
+    put16(out, files.size());
+    put16(out, symbols.size());
+    put32(out, lines.size());
+    for (const auto &file : files) {
+        if (file.size() > 0xffff) {
+            throw std::runtime_error("file name '" + file + "' is too long");
+        }
+        put16(out, file.size());
+        out += file;
+    }
+    for (const auto &symbol : symbols) {
+        if (symbol.name.size() > 0xff) {
+            throw std::runtime_error("symbol name '" + symbol.name +
+                                     "' is too long");
+        }
+        put16(out, symbol.address);
+        out.push_back(symbol.name.size());
+        out += symbol.name;
+    }
+    for (const auto &line : lines) {
+        put16(out, line.address);
+        out.push_back(line.size);
+        put16(out, line.file);
+        put32(out, line.number);
+    }
+    std::ofstream os(path, std::ios::binary);
+    if (!os.write(out.data(), out.size())) {
+        throw std::runtime_error("could not write '" + path.string() + "'");
+    }
+}
+
+SymbolMap SymbolMap::read(const std::filesystem::path &path) {
+    MappedFile file(path);
+    std::string name = path.string();
+    Reader reader(file.data(), file.size(), name);
+    if (std::memcmp(reader.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("'" + name + "' is not a symbol map");
+    }
+    SymbolMap map;
+    map.files.resize(reader.get16());
+    map.symbols.resize(reader.get16());
+    uint32_t line_count = reader.get32();
+    if (line_count > reader.remaining() / LINE_SIZE) {
+        throw std::runtime_error("'" + name + "' is truncated");
+    }
+    map.lines.resize(line_count);
+    for (auto &file : map.files) {
+        file = reader.getString(reader.get16());
+    }
+    for (auto &symbol : map.symbols) {
+        symbol.address = reader.get16();
+        symbol.name = reader.getString(reader.get8());
+    }
+    for (auto &line : map.lines) {
+        line.address = reader.get16();
+        line.size = reader.get8();
+        line.file = reader.get16();
+        line.number = reader.get32();
+        if (line.file >= map.files.size()) {
+            throw std::runtime_error("'" + name + "' has a bad line entry");
+        }
+    }
+    // Lookups rely on the order, so do not trust the writer for it
+    map.sort();
+    return map;
+}
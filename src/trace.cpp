@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace {
+constexpr char MAGIC[8] = {'I', '8', '0', '8', '0', 'T', 'R', 'C'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t INITIAL_RECORDS = 1 << 20;
+
+size_t fileSize(size_t records) {
+    return sizeof(TraceHeader) + records * sizeof(TraceRecord);
+}
+} // namespace
+
+std::string formatRecord(const TraceRecord &r) {
+    // PC=%%%%(%%) A=%% SZAPC=%%%%% BC=%%%% DE=%%%% HL=%%%%
+    char line[96];
+    uint8_t flags = r.PSW & 0xff;
+    std::snprintf(line, sizeof(line),
+                  "PC=%04x[%02x] A=%02x SZAPC=%d%d%d%d%d BC=%04x DE=%04x "
+                  "HL=%04x SP=%04x[%04x]",
+                  r.PC, r.opcode, r.PSW >> 8, (flags >> 7) & 1,
+                  (flags >> 6) & 1, (flags >> 4) & 1, (flags >> 2) & 1,
+                  flags & 1, r.BC, r.DE, r.HL, r.SP, r.stack);
+    return line;
+}
+
+Tracer::Tracer(const std::filesystem::path &path) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create '" + path.string() + "'");
+    }
+    try {
+        map(INITIAL_RECORDS);
+    } catch (std::runtime_error &) {
+        close(fd);
+        throw;
+    }
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->version = VERSION;
+    header->record_size = sizeof(TraceRecord);
+    header->count = 0;
+    next = begin;
+}
+
+Tracer::Tracer(size_t capacity) : capacity(capacity), ring(capacity) {
+    if (capacity == 0) {
+        throw std::runtime_error("Trace ring needs at least one record");
+    }
+    begin = next = ring.data();
+    end = begin + capacity;
+}
+
+Tracer::~Tracer() {
+    if (fd < 0) {
+        return;
+    }
+    // Unmapped if advance() failed, which already stored the count
+    if (header != nullptr) {
+        uint64_t records = next - begin;
+        header->count = records;
+        munmap(header, fileSize(capacity));
+        if (ftruncate(fd, fileSize(records)) < 0) {
+            std::perror("trace");
+        }
+    }
+    close(fd);
+}
+
+uint64_t Tracer::count() const { return wrapped ? capacity : next - begin; }
+
+void Tracer::advance() {
+    if (fd < 0) {
+        wrapped = true;
+        next = begin;
+        return;
+    }
+    if (header == nullptr) {
+        throw std::runtime_error("Trace file is not mapped");
+    }
+    size_t records = next - begin;
+    header->count = records;
+    munmap(header, fileSize(capacity));
+    header = nullptr;
+    begin = next = end = nullptr;
+    map(capacity * 2);
+    next = begin + records;
+}
+
+void Tracer::map(size_t records) {
+    if (ftruncate(fd, fileSize(records)) < 0) {
+        throw std::runtime_error("Failed to grow trace file");
+    }
+    void *mapping = mmap(nullptr, fileSize(records), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map trace file");
+    }
+    capacity = records;
+    header = static_cast<TraceHeader *>(mapping);
+    begin = reinterpret_cast<TraceRecord *>(header + 1);
+    end = begin + capacity;
+}
+
+void Tracer::save(const std::filesystem::path &path) const {
+    TraceHeader out;
+    std::memcpy(out.magic, MAGIC, sizeof(MAGIC));
+    out.version = VERSION;
+    out.record_size = sizeof(TraceRecord);
+    out.count = count();
+
+    std::ofstream os(path, std::ios::binary);
+    os.write(reinterpret_cast<const char *>(&out), sizeof(out));
+    auto write = [&os](const TraceRecord *from, const TraceRecord *to) {
+        os.write(reinterpret_cast<const char *>(from),
+                 (to - from) * sizeof(TraceRecord));
+    };
+    if (wrapped) {
+        write(next, end);
+    }
+    write(begin, next);
+    if (!os) {
+        throw std::runtime_error("Failed to write '" + path.string() + "'");
+    }
+}
+
+TraceReader::TraceReader(const std::filesystem::path &path) : file(path) {
+    const auto *header = reinterpret_cast<const TraceHeader *>(file.data());
+    if (file.size() < sizeof(TraceHeader) ||
+        std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header->version != VERSION ||
+        header->record_size != sizeof(TraceRecord)) {
+        throw std::runtime_error("'" + path.string() + "' is not a trace");
+    }
+    records = reinterpret_cast<const TraceRecord *>(header + 1);
+    length = std::min<size_t>(header->count, (file.size() - sizeof(*header)) /
+                                                 sizeof(TraceRecord));
+}
@@ -0,0 +1,130 @@
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "disassembler.h"
+#include "symbol_map.h"
+#include "trace.h"
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name
+              << " [-s FIRST] [-n COUNT] [-p LOW[-HIGH]] [-o OPCODE] [-c]"
+              << " [-d] [-m MAP] TRACE" << std::endl
+              << "  -s FIRST        skip records before index FIRST" << std::endl
+              << "  -n COUNT        print at most COUNT records" << std::endl
+              << "  -p LOW[-HIGH]   only records with PC in LOW..HIGH (hex)"
+              << std::endl
+              << "  -o OPCODE       only records executing OPCODE (hex)"
+              << std::endl
+              << "  -c              prefix each record with its cycle count"
+              << std::endl
+              << "  -d              follow each record with its opcode, e.g. "
+                 "MOV A,M"
+              << std::endl
+              << "  -m MAP          follow each record with its label and "
+                 "source line"
+              << std::endl
+              << "                  from a symbol map written by bin/asm -m"
+              << std::endl;
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    size_t first = 0;
+    size_t limit = SIZE_MAX;
+    uint16_t low = 0x0000, high = 0xffff;
+    int opcode = -1;
+    bool cycles = false;
+    bool instructions = false;
+    const char *path = nullptr;
+    const char *map_path = nullptr;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                first = std::stoull(argv[++i]);
+            } else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+                limit = std::stoull(argv[++i]);
+            } else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+                std::string range = argv[++i];
+                auto dash = range.find('-');
+                low = std::stoul(range.substr(0, dash), nullptr, 16);
+                high = dash == std::string::npos
+                           ? low
+                           : std::stoul(range.substr(dash + 1), nullptr, 16);
+            } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                opcode = std::stoul(argv[++i], nullptr, 16) & 0xff;
+            } else if (std::strcmp(argv[i], "-c") == 0) {
+                cycles = true;
+            } else if (std::strcmp(argv[i], "-d") == 0) {
+                instructions = true;
+            } else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+                map_path = argv[++i];
+            } else if (argv[i][0] == '-' || path != nullptr) {
+                return usage(argv[0]);
+            } else {
+                path = argv[i];
+            }
+        }
+    } catch (std::logic_error &e) {
+        return usage(argv[0]);
+    }
+    if (path == nullptr) {
+        return usage(argv[0]);
+    }
+
+    try {
+        TraceReader trace(path);
+        std::optional<SymbolMap> symbols;
+        // Each PC is described once; traces revisit the same few a lot
+        std::vector<std::string> where;
+        std::vector<bool> described;
+        if (map_path != nullptr) {
+            symbols = SymbolMap::read(map_path);
+            where.resize(0x10000);
+            described.resize(0x10000);
+        }
+        std::string out;
+        size_t printed = 0;
+        for (auto it = trace.begin() + std::min(first, trace.size());
+             it != trace.end() && printed < limit; ++it) {
+            if (it->PC < low || it->PC > high ||
+                (opcode >= 0 && it->opcode != opcode)) {
+                continue;
+            }
+            if (cycles) {
+                out += std::to_string(it->cycles);
+                out += ' ';
+            }
+            out += formatRecord(*it);
+            if (instructions) {
+                // Records keep the opcode but not its operand bytes
+                out += "  ";
+                out += opcodeName(it->opcode);
+            }
+            if (symbols) {
+                if (!described[it->PC]) {
+                    where[it->PC] = symbols->describe(it->PC);
+                    described[it->PC] = true;
+                }
+                if (!where[it->PC].empty()) {
+                    out += "  ; ";
+                    out += where[it->PC];
+                }
+            }
+            out += '\n';
+            printed++;
+            if (out.size() > 0x10000) {
+                std::cout.write(out.data(), out.size());
+                out.clear();
+            }
+        }
+        std::cout.write(out.data(), out.size());
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "emulator.h"
+
+// Exhaustive check of the ALU and its flags. Every accumulator x operand x
+// carry x auxiliary carry combination of each ALU instruction (register and
+// immediate forms), and every accumulator x carry x auxiliary carry input of
+// DAA, INR and DCR, is executed on the core and compared against an
+// independent reference model. The model works on 8 operands at a time
+// using GCC vector extensions.
+
+using Lanes = uint16_t __attribute__((vector_size(16)));
+constexpr int LANES = sizeof(Lanes) / sizeof(uint16_t);
+
+enum class Op { ADD, ADC, SUB, SBB, ANA, XRA, ORA, CMP, DAA, INR, DCR };
+
+struct Instruction {
+    const char *name;
+    Op op;
+    uint8_t opcode;
+    bool immediate;
+};
+
+const Instruction binary[] = {
+    {"ADD B", Op::ADD, 0x80, false}, {"ADC B", Op::ADC, 0x88, false},
+    {"SUB B", Op::SUB, 0x90, false}, {"SBB B", Op::SBB, 0x98, false},
+    {"ANA B", Op::ANA, 0xa0, false}, {"XRA B", Op::XRA, 0xa8, false},
+    {"ORA B", Op::ORA, 0xb0, false}, {"CMP B", Op::CMP, 0xb8, false},
+    {"ADI", Op::ADD, 0xc6, true},    {"ACI", Op::ADC, 0xce, true},
+    {"SUI", Op::SUB, 0xd6, true},    {"SBI", Op::SBB, 0xde, true},
+    {"ANI", Op::ANA, 0xe6, true},    {"XRI", Op::XRA, 0xee, true},
+    {"ORI", Op::ORA, 0xf6, true},    {"CPI", Op::CMP, 0xfe, true},
+};
+
+const Instruction unary[] = {
+    {"DAA", Op::DAA, 0x27, false},
+    {"INR A", Op::INR, 0x3c, false},
+    {"DCR A", Op::DCR, 0x3d, false},
+};
+
+Lanes iota(uint16_t base) {
+    Lanes v;
+    for (int i = 0; i < LANES; i++) {
+        v[i] = base + i;
+    }
+    return v;
+}
+
+Lanes parity(Lanes r) {
+    Lanes p = r ^ (r >> 4);
+    p ^= p >> 2;
+    p ^= p >> 1;
+    return ~p & 1;
+}
+
+// Flag byte with the unused bits as the core leaves them (bit 1 set)
+Lanes flags(Lanes r, Lanes cy, Lanes ac) {
+    r &= 0xff;
+    Lanes z = (Lanes)(r == 0) & 1;
+    return (r >> 7) << 7 | z << 6 | ac << 4 | parity(r) << 2 | 2 | cy;
+}
+
+// Reference results of a binary operation for A = a and operands 0..255
+void modelBinary(Op op, uint8_t a, uint16_t carry, uint8_t *result,
+                 uint8_t *flag) {
+    for (int base = 0; base < 0x100; base += LANES) {
+        Lanes A = Lanes{} + a;
+        Lanes b = iota(base);
+        uint16_t carry_in = (op == Op::ADC || op == Op::SBB) ? carry : 0;
+        Lanes c = Lanes{} + carry_in;
+        Lanes r, cy, ac;
+        switch (op) {
+        case Op::ADD:
+        case Op::ADC:
+            r = A + b + c;
+            cy = (r >> 8) & 1;
+            ac = (((A & 0xf) + (b & 0xf) + c) >> 4) & 1;
+            break;
+        case Op::SUB:
+        case Op::SBB:
+        case Op::CMP:
+            // The 8080 sets AC when the low nibble does not borrow
+            r = A - b - c;
+            cy = (r >> 8) & 1;
+            ac = (((A & 0xf) + 0x10 - (b & 0xf) - c) >> 4) & 1;
+            break;
+        case Op::ANA:
+            r = A & b;
+            cy = Lanes{};
+            ac = ((A | b) >> 3) & 1;
+            break;
+        case Op::XRA:
+            r = A ^ b;
+            cy = ac = Lanes{};
+            break;
+        case Op::ORA:
+            r = A | b;
+            cy = ac = Lanes{};
+            break;
+        default:
+            return;
+        }
+        Lanes f = flags(r, cy, ac);
+        if (op == Op::CMP) {
+            r = A;
+        }
+        for (int i = 0; i < LANES; i++) {
+            result[base + i] = r[i];
+            flag[base + i] = f[i];
+        }
+    }
+}
+
+// Reference results of a unary operation for A = 0..255
+void modelUnary(Op op, uint16_t carry, uint16_t aux, uint8_t *result,
+                uint8_t *flag) {
+    for (int base = 0; base < 0x100; base += LANES) {
+        Lanes A = iota(base);
+        Lanes C = Lanes{} + carry;
+        Lanes r, cy, ac;
+        switch (op) {
+        case Op::DAA: {
+            Lanes low = (Lanes)((A & 0xf) > 9) | (Lanes{} - aux);
+            Lanes high = (Lanes)(A > 0x99) | (Lanes{} - carry);
+            Lanes adjust = (low & 0x06) | (high & 0x60);
+            r = A + adjust;
+            cy = high & 1;
+            ac = (((A & 0xf) + (adjust & 0xf)) >> 4) & 1;
+            break;
+        }
+        case Op::INR:
+            r = A + 1;
+            cy = C;
+            ac = (((A & 0xf) + 1) >> 4) & 1;
+            break;
+        case Op::DCR:
+            // Decrement is an add of 0xff, AC is the carry out of bit 3
+            r = A - 1;
+            cy = C;
+            ac = (((A & 0xf) + 0xf) >> 4) & 1;
+            break;
+        default:
+            return;
+        }
+        Lanes f = flags(r, cy, ac);
+        for (int i = 0; i < LANES; i++) {
+            result[base + i] = r[i];
+            flag[base + i] = f[i];
+        }
+    }
+}
+
+struct Checker {
+    std::unique_ptr<Intel8080> cpu = std::make_unique<Intel8080>();
+    uint64_t checks = 0;
+    uint64_t failures = 0;
+    double model_seconds = 0;
+    double core_seconds = 0;
+
+    void report(const Instruction &inst, uint8_t a, int b, bool carry,
+                bool aux, uint8_t result, uint8_t flag) {
+        if (++failures > 10) {
+            return;
+        }
+        std::cout << std::hex << std::setfill('0') << inst.name
+                  << ": A=" << std::setw(2) << (int)a;
+        if (b >= 0) {
+            std::cout << " operand=" << std::setw(2) << b;
+        }
+        std::cout << " CY=" << carry << " AC=" << aux << " expected A="
+                  << std::setw(2) << (int)result << " F=" << std::setw(2)
+                  << (int)flag << ", got A=" << std::setw(2) << (int)cpu->A
+                  << " F=" << std::setw(2) << (cpu->PSW & 0xff) << std::dec
+                  << std::endl;
+    }
+
+    // Runs `opcode` with the given inputs and compares A and the flags
+    bool execute(uint8_t opcode, uint8_t a, uint8_t b, bool carry, bool aux,
+                 uint8_t result, uint8_t flag) {
+        cpu->PC = 0;
+        cpu->A = a;
+        cpu->B = b;
+        cpu->PSW = (cpu->PSW & 0xff00) | 0x02 | aux << 4 | carry;
+        cpu->memory[0] = opcode;
+        cpu->memory[1] = b;
+        cpu->execute(1);
+        checks++;
+        return cpu->A == result && (cpu->PSW & 0xff) == flag;
+    }
+
+    uint64_t check(const Instruction &inst) {
+        uint64_t before = failures;
+        uint8_t result[0x100], flag[0x100];
+        for (int carry = 0; carry < 2; carry++) {
+            for (int aux = 0; aux < 2; aux++) {
+                if (inst.op == Op::DAA || inst.op == Op::INR ||
+                    inst.op == Op::DCR) {
+                    auto start = std::chrono::steady_clock::now();
+                    modelUnary(inst.op, carry, aux, result, flag);
+                    auto middle = std::chrono::steady_clock::now();
+                    for (int a = 0; a < 0x100; a++) {
+                        if (!execute(inst.opcode, a, 0, carry, aux, result[a],
+                                     flag[a])) {
+                            report(inst, a, -1, carry, aux, result[a], flag[a]);
+                        }
+                    }
+                    tally(start, middle);
+                    continue;
+                }
+                for (int a = 0; a < 0x100; a++) {
+                    auto start = std::chrono::steady_clock::now();
+                    modelBinary(inst.op, a, carry, result, flag);
+                    auto middle = std::chrono::steady_clock::now();
+                    for (int b = 0; b < 0x100; b++) {
+                        if (!execute(inst.opcode, a, b, carry, aux, result[b],
+                                     flag[b])) {
+                            report(inst, a, b, carry, aux, result[b], flag[b]);
+                        }
+                    }
+                    tally(start, middle);
+                }
+            }
+        }
+        return failures - before;
+    }
+
+    void tally(std::chrono::steady_clock::time_point start,
+               std::chrono::steady_clock::time_point middle) {
+        auto end = std::chrono::steady_clock::now();
+        model_seconds += std::chrono::duration<double>(middle - start).count();
+        core_seconds += std::chrono::duration<double>(end - middle).count();
+    }
+};
+
+int main() {
+    Checker checker;
+    for (const auto &inst : binary) {
+        auto failed = checker.check(inst);
+        std::cout << std::left << std::setw(6) << inst.name << std::right
+                  << (failed == 0 ? " OK" : " FAILED") << std::endl;
+    }
+    for (const auto &inst : unary) {
+        auto failed = checker.check(inst);
+        std::cout << std::left << std::setw(6) << inst.name << std::right
+                  << (failed == 0 ? " OK" : " FAILED") << std::endl;
+    }
+    std::cout << checker.checks << " combinations, " << checker.failures
+              << " failures; model " << std::fixed << std::setprecision(1)
+              << checker.checks / checker.model_seconds / 1e6
+              << " M/s, core " << checker.checks / checker.core_seconds / 1e6
+              << " M/s" << std::endl;
+    return checker.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,477 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assembler.h"
+#include "assembly_cache.h"
+#include "assembly_syntax.h"
+#include "disassembler.h"
+#include "instruction_set.h"
+#include "linker.h"
+#include "object.h"
+
+// Checks of the assembler toolchain: every documented opcode survives a
+// trip through the disassembler and back, numbers parse in every radix and
+// fail outside their range, malformed lines are reported rather than
+// assembled, objects link, or fail to, as they should, and the incremental
+// cache gives the same binary as assembling from scratch.
+
+namespace {
+struct Checker {
+    uint64_t checks = 0;
+    uint64_t failures = 0;
+
+    bool check(bool ok, const std::string &what) {
+        checks++;
+        if (!ok && ++failures <= 20) {
+            std::cout << "  " << what << std::endl;
+        }
+        return ok;
+    }
+};
+
+std::string hex(const std::vector<uint8_t> &bytes) {
+    std::string out;
+    char text[4];
+    for (auto byte : bytes) {
+        std::snprintf(text, sizeof(text), "%02x ", byte);
+        out += text;
+    }
+    return out;
+}
+
+// Assembles `source` and returns the first error, or "" if there was none
+std::string assembleError(std::string_view source,
+                          std::vector<uint8_t> *program = nullptr) {
+    Intel8080Assembler assembler(source);
+    auto bytes = assembler.assemble();
+    if (program != nullptr) {
+        *program = bytes;
+    }
+    return assembler.hadErrors() ? assembler.errors().front().message : "";
+}
+
+void roundTrip(Checker &checker) {
+    size_t documented = 0;
+    for (unsigned op = 0; op < 0x100; op++) {
+        if (!OPCODES[op].documented) {
+            continue;
+        }
+        documented++;
+        Instruction instruction{0, {uint8_t(op), 0x34, 0x12}};
+        std::string text = disassemble(instruction);
+        std::vector<uint8_t> program;
+        std::string error = assembleError(text, &program);
+        std::vector<uint8_t> expected(instruction.bytes,
+                                      instruction.bytes +
+                                          instruction.length());
+        checker.check(error.empty() && program == expected,
+                      "'" + text + "' assembles to " + hex(program) +
+                          error + ", expected " + hex(expected));
+    }
+    checker.check(documented == 244, "expected 244 documented opcodes, not " +
+                                         std::to_string(documented));
+}
+
+void numbers(Checker &checker) {
+    struct Case {
+        const char *source;
+        std::vector<uint8_t> bytes;
+    };
+    const Case good[] = {
+        {"MVI A,255", {0x3e, 0xff}},
+        {"MVI A,255D", {0x3e, 0xff}},
+        {"MVI A,0FFH", {0x3e, 0xff}},
+        {"MVI A,0ffh", {0x3e, 0xff}},
+        {"MVI A,377O", {0x3e, 0xff}},
+        {"MVI A,377Q", {0x3e, 0xff}},
+        {"MVI A,11111111B", {0x3e, 0xff}},
+        {"MVI A,'A'", {0x3e, 0x41}},
+        {"MVI A,' '", {0x3e, 0x20}},
+        {"MVI A,0", {0x3e, 0x00}},
+        {"LXI H,0FFFFH", {0x21, 0xff, 0xff}},
+        {"LXI H,65535", {0x21, 0xff, 0xff}},
+        {"LXI H,177777Q", {0x21, 0xff, 0xff}},
+        {"JMP 1234H", {0xc3, 0x34, 0x12}},
+        {"RST 7", {0xff}},
+    };
+    for (const auto &c : good) {
+        std::vector<uint8_t> program;
+        std::string error = assembleError(c.source, &program);
+        checker.check(error.empty() && program == c.bytes,
+                      std::string("'") + c.source + "' assembles to " +
+                          hex(program) + error + ", expected " +
+                          hex(c.bytes));
+    }
+
+    struct Bad {
+        const char *source;
+        const char *error;
+    };
+    const Bad bad[] = {
+        {"MVI A,256", "out of range"},
+        {"MVI A,100H", "out of range"},
+        {"MVI A,400Q", "out of range"},
+        {"MVI A,100000000B", "out of range"},
+        {"LXI H,10000H", "out of range"},
+        {"LXI H,65536", "out of range"},
+        {"LXI H,99999999999999999999", "out of range"},
+        {"RST 8", "out of range"},
+        {"MVI A,0FFX", "could not parse number"},
+        {"MVI A,12H3", "could not parse number"},
+        {"MVI A,2B", "could not parse number"},
+        {"MVI A,9Q", "could not parse number"},
+        {"MVI A,H", "could not parse number"},
+        {"MVI A,'AB'", "invalid ascii literal"},
+        {"JMP nowhere", "could not resolve label 'nowhere'"},
+    };
+    for (const auto &c : bad) {
+        std::string error = assembleError(c.source);
+        checker.check(error.find(c.error) != std::string::npos,
+                      std::string("'") + c.source + "' gives '" + error +
+                          "', expected '" + c.error + "'");
+    }
+}
+
+void lexer(Checker &checker) {
+    struct Case {
+        const char *source;
+        const char *error;
+    };
+    const Case cases[] = {
+        {", a", "expected label or mnemonic"},
+        {"  ,", "expected label or mnemonic"},
+        {": nop", "empty label"},
+        {"mov a,b,c", "unexpected token after operands"},
+        {"mov a,", "expected operand after ','"},
+        {"mov a, ; comment", "expected operand after ','"},
+        {"mov ,b", "expected operand"},
+        {"mov a b", "expected comment or end of line"},
+        {"x: nop\nx: nop", "label 'x' already defined"},
+    };
+    for (const auto &c : cases) {
+        std::string error = assembleError(c.source);
+        checker.check(error.find(c.error) != std::string::npos,
+                      std::string("'") + c.source + "' gives '" + error +
+                          "', expected '" + c.error + "'");
+    }
+
+    // Lines that are fine, straight through the lexer
+    syntax::SourceLine line;
+    auto fail = [&](std::string_view message, std::string_view) {
+        checker.check(false, "unexpected error " + std::string(message));
+    };
+    checker.check(syntax::lexLine("", line, fail) && line.mnemonic.empty(),
+                  "empty line");
+    checker.check(syntax::lexLine("  ; only a comment", line, fail) &&
+                      line.mnemonic.empty(),
+                  "comment line");
+    checker.check(syntax::lexLine("loop: MVI A,';' ; x", line, fail) &&
+                      line.label == "loop" && line.mnemonic == "MVI" &&
+                      line.operand_count == 2 && line.operands[1] == "';'",
+                  "label, mnemonic and a ';' literal");
+    checker.check(syntax::lexLine("end:", line, fail) && line.label == "end" &&
+                      line.mnemonic.empty(),
+                  "label on its own");
+}
+Object object(std::string_view source) {
+    Intel8080Assembler assembler(source);
+    return assembler.assembleObject();
+}
+
+// Links `objects` at their origins and returns the first error, or ""
+std::string linkError(
+    const std::vector<std::pair<const Object *, std::optional<uint16_t>>>
+        &objects,
+    std::vector<uint8_t> *image = nullptr) {
+    Linker linker;
+    for (size_t i = 0; i < objects.size(); i++) {
+        linker.add("unit" + std::to_string(i), *objects[i].first,
+                   objects[i].second);
+    }
+    auto linked = linker.link();
+    if (image != nullptr) {
+        *image = linked;
+    }
+    return linker.hadErrors() ? linker.errors().front() : "";
+}
+
+void linker(Checker &checker) {
+    auto main = object("start: CALL print\n"
+                       "@loop: JMP @loop\n");
+    auto lib = object("print: MVI C,2\n"
+                      "@loop: DCR C\n"
+                      "       JNZ @loop\n"
+                      "       JMP start\n");
+    std::vector<uint8_t> image;
+    std::string error = linkError({{&main, 0x100}, {&lib, std::nullopt}},
+                                  &image);
+    std::vector<uint8_t> expected = {
+        0xcd, 0x06, 0x01, // CALL print
+        0xc3, 0x03, 0x01, // JMP @loop in main
+        0x0e, 0x02,       // print: MVI C,2
+        0x0d,             // DCR C
+        0xc2, 0x08, 0x01, // JNZ @loop in lib
+        0xc3, 0x00, 0x01, // JMP start
+    };
+    checker.check(error.empty() && image == expected,
+                  "cross-file link gives " + hex(image) + error +
+                      ", expected " + hex(expected));
+
+    auto loop1 = object("loop: JMP loop\n");
+    auto loop2 = object("loop: JMP loop\n");
+    error = linkError({{&loop1, 0}, {&loop2, std::nullopt}});
+    checker.check(error == "'loop' is defined in unit0 and unit1",
+                  "duplicate symbol gives '" + error + "'");
+
+    auto caller = object("CALL nowhere\n");
+    error = linkError({{&caller, 0}});
+    checker.check(error == "unit0: undefined symbol 'nowhere'",
+                  "undefined symbol gives '" + error + "'");
+
+    error = linkError({{&main, 0x100}, {&lib, 0x104}});
+    checker.check(error == "unit0 overlaps unit1",
+                  "overlap gives '" + error + "'");
+    error = linkError({{&lib, 0xfff8}});
+    checker.check(error == "unit0 ends past 0xffff",
+                  "overflow gives '" + error + "'");
+
+    Intel8080Assembler local("JMP @missing\n");
+    local.assembleObject();
+    checker.check(local.hadErrors() &&
+                      local.errors().front().message ==
+                          "could not resolve local label '@missing'",
+                  "undefined local label is not reported");
+
+    // Every truncation of a valid object is rejected, through the file too
+    std::string bytes;
+    lib.serialize(bytes);
+    auto data = reinterpret_cast<const uint8_t *>(bytes.data());
+    auto parsed = Object::parse(data, bytes.size(), "lib.o");
+    checker.check(parsed.code == lib.code &&
+                      parsed.symbols.size() == lib.symbols.size() &&
+                      parsed.symbols[1].local &&
+                      parsed.relocations.size() == lib.relocations.size(),
+                  "object does not survive serialize() and parse()");
+    auto path = std::filesystem::temp_directory_path() / "asmcheck.o";
+    for (size_t size = 0; size < bytes.size(); size++) {
+        std::string message;
+        try {
+            if (size % 8 == 0) {
+                std::ofstream(path, std::ios::binary).write(bytes.data(), size);
+                Object::read(path);
+            } else {
+                Object::parse(data, size, path.string());
+            }
+        } catch (std::runtime_error &e) {
+            message = e.what();
+        }
+        checker.check(message.find("truncated") != std::string::npos ||
+                          (size == 0 && !message.empty()),
+                      "object truncated to " + std::to_string(size) +
+                          " bytes gives '" + message + "'");
+    }
+    std::filesystem::remove(path);
+
+    bytes.push_back(0);
+    std::string message;
+    try {
+        Object::parse(reinterpret_cast<const uint8_t *>(bytes.data()),
+                      bytes.size(), "lib.o");
+    } catch (std::runtime_error &e) {
+        message = e.what();
+    }
+    checker.check(message.find("trailing") != std::string::npos,
+                  "object with a trailing byte gives '" + message + "'");
+
+    // A full 64 KiB would wrap the u16 code size to an empty object
+    Object full;
+    full.code.resize(0x10000);
+    message.clear();
+    try {
+        std::string out;
+        full.serialize(out);
+    } catch (std::runtime_error &e) {
+        message = e.what();
+    }
+    checker.check(message == "object is too large",
+                  "64 KiB object gives '" + message + "'");
+}
+// A few thousand lines of labels, forward and backward references, local
+// labels, comments and blank lines
+std::string generateSource(size_t lines) {
+    std::string source;
+    uint32_t seed = 1;
+    auto random = [&seed](uint32_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % n;
+    };
+    size_t labels = lines / 8;
+    for (size_t i = 0; i < lines; i++) {
+        if (i % 8 == 0) {
+            source += "l" + std::to_string(i / 8) + ":";
+        }
+        switch (random(8)) {
+        case 0:
+            source += " JMP l" + std::to_string(random(labels)) + "\n";
+            break;
+        case 1:
+            source += " CALL l" + std::to_string(random(labels)) + "\n";
+            break;
+        case 2:
+            source += " LXI H,l" + std::to_string(random(labels)) + "\n";
+            break;
+        case 3:
+            source += " MVI A," + std::to_string(random(256)) + " ; byte\n";
+            break;
+        case 4:
+            source += "\n";
+            break;
+        case 5:
+            if (i % 8 != 0) {
+                source += "@l" + std::to_string(i) + ": JNZ @l" +
+                          std::to_string(i) + "\n";
+                break;
+            }
+            source += " NOP\n";
+            break;
+        default:
+            source += " MOV A,B\n";
+            break;
+        }
+    }
+    return source;
+}
+
+void cache(Checker &checker) {
+    auto path = std::filesystem::temp_directory_path() / "asmcheck.cache";
+    std::filesystem::remove(path);
+    // Assembles through a cache loaded from `path`, compares the result
+    // with assembling from scratch and saves the cache
+    auto same = [&](const std::string &source, const std::string &what,
+                    size_t *misses = nullptr, size_t *hits = nullptr) {
+        Intel8080Assembler assembler(source);
+        auto expected = assembler.assemble();
+        std::vector<std::string> errors;
+        AssemblyCache cache(path);
+        auto program = cache.assemble(source, "source", errors);
+        cache.save();
+        if (misses != nullptr) {
+            *misses = cache.misses();
+            *hits = cache.hits();
+        }
+        return checker.check(!assembler.hadErrors() && errors.empty() &&
+                                 program == expected,
+                             what + " does not match assembling from scratch");
+    };
+
+    auto source = generateSource(3000);
+    size_t misses, hits;
+    same(source, "a fresh cache", &misses, &hits);
+    checker.check(misses > 10 && hits == 0, "a fresh cache had " +
+                                                std::to_string(hits) +
+                                                " hits");
+    size_t chunks = misses;
+    same(source, "an unchanged source", &misses, &hits);
+    checker.check(misses == 0 && hits == chunks,
+                  "an unchanged source had " + std::to_string(misses) +
+                      " misses");
+
+    // An edit in the middle moves every address after it
+    auto edited = source;
+    size_t middle = edited.find("\n", edited.size() / 2) + 1;
+    edited.insert(middle, " MVI B,1\n");
+    same(edited, "an inserted line", &misses, &hits);
+    checker.check(misses >= 1 && misses <= 2 && hits + misses <= chunks + 1,
+                  "an inserted line had " + std::to_string(misses) +
+                      " misses");
+    edited.replace(edited.find(" MOV A,B"), 8, " MOV A,C");
+    same(edited, "an edited line");
+    edited.insert(middle, "late: XRA A\n JMP late\n JMP l3\n");
+    edited.insert(0, "@far: JMP late\n");
+    edited += " JMP @far\n";
+    same(edited, "inserted labels and references");
+    same(edited.substr(0, edited.size() - 1), "a missing final newline");
+
+    // The same line over and over is either a chunk boundary every time
+    // or never, in which case chunks stop at MAX_CHUNK_LINES
+    bool capped = false;
+    for (const char *line : {" NOP\n", " MOV A,B\n", " XRA A\n", " INX H\n"}) {
+        std::string repeated;
+        for (size_t i = 0; i < 3000; i++) {
+            repeated += line;
+        }
+        std::filesystem::remove(path);
+        same(repeated, "repeated lines", &misses, &hits);
+        // 1024 + 1024 + 952 lines, the second a hit on the first
+        capped |= misses == 2 && hits == 1;
+    }
+    checker.check(capped, "no chunk reached MAX_CHUNK_LINES");
+
+    // Errors name the line in the whole source
+    std::vector<std::string> errors;
+    auto broken = source;
+    broken.insert(middle, " MVI A,256\n");
+    Intel8080Assembler assembler(broken);
+    assembler.assemble();
+    AssemblyCache(path).assemble(broken, "source", errors);
+    checker.check(assembler.hadErrors() && errors.size() == 1 &&
+                      errors.front() ==
+                          "source:" +
+                              std::to_string(assembler.errors()[0].line) +
+                              ": error: " + assembler.errors()[0].message,
+                  "error in a chunk gives '" +
+                      (errors.empty() ? "" : errors.front()) + "'");
+
+    // A damaged cache file is treated as empty
+    same(source, "a source cached again");
+    std::string good;
+    {
+        std::ifstream is(path, std::ios::binary);
+        good.assign(std::istreambuf_iterator<char>(is), {});
+    }
+    for (size_t size : {size_t(0), size_t(3), size_t(8), good.size() / 3,
+                        good.size() - 1}) {
+        std::ofstream(path, std::ios::binary).write(good.data(), size);
+        same(source, "a cache truncated to " + std::to_string(size) + " bytes",
+             &misses, &hits);
+        checker.check(hits == 0, "a cache truncated to " +
+                                     std::to_string(size) + " bytes had " +
+                                     std::to_string(hits) + " hits");
+    }
+    std::ofstream(path, std::ios::binary) << "not a cache at all";
+    same(source, "a cache with a bad magic");
+    std::filesystem::remove(path);
+}
+} // namespace
+
+int main() {
+    struct Group {
+        const char *name;
+        void (*run)(Checker &);
+    };
+    const Group groups[] = {
+        {"opcodes", roundTrip},
+        {"numbers", numbers},
+        {"lexer", lexer},
+        {"linker", linker},
+        {"cache", cache},
+    };
+    Checker checker;
+    for (const auto &group : groups) {
+        uint64_t before = checker.failures;
+        group.run(checker);
+        std::cout << std::left << std::setw(10) << group.name << std::right
+                  << (checker.failures == before ? " OK" : " FAILED")
+                  << std::endl;
+    }
+    std::cout << checker.checks << " checks, " << checker.failures
+              << " failures" << std::endl;
+    return checker.failures == 0 ? 0 : 1;
+}
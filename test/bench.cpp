@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "access_map.h"
+#include "capture.h"
+#include "constexpr_assembler.h"
+#include "cpm.h"
+#include "emulator.h"
+#include "invaders_batch.h"
+#include "mapped_file.h"
+#include "space_invaders.h"
+
+// Microbenchmarks are endless loops at 0x0000 run for a fixed cycle budget.
+
+template <size_t N>
+std::vector<uint8_t> bytes(const std::array<uint8_t, N> &program) {
+    return {program.begin(), program.end()};
+}
+
+// MOV r,r between all registers
+const std::vector<uint8_t> movLoop = bytes(assemble8080<R"(
+loop:   MOV B,C
+        MOV C,D
+        MOV D,E
+        MOV E,H
+        MOV H,L
+        MOV L,A
+        MOV A,B
+        MOV B,A
+        MOV B,C
+        MOV C,D
+        MOV D,E
+        MOV E,H
+        MOV H,L
+        MOV L,A
+        MOV A,B
+        MOV B,A
+        JMP loop
+)">());
+
+// Register and immediate ALU operations
+const std::vector<uint8_t> aluLoop = bytes(assemble8080<R"(
+loop:   ADD B
+        ADC C
+        SUB D
+        SBB E
+        ANA H
+        XRA L
+        ORA A
+        CMP B
+        ADI 05H
+        ACI 03H
+        SUI 07H
+        XRI 5AH
+        ORI 01H
+        ANI 7FH
+        CPI 10H
+        DAA
+        INR A
+        DCR B
+        JMP loop
+)">());
+
+// Taken and not taken conditional jumps on every condition
+const std::vector<uint8_t> branchLoop = bytes(assemble8080<R"(
+loop:   INR A
+        JZ zero
+        JNZ zero
+zero:   ORA A
+        JC loop
+        JP sign
+        JM sign
+sign:   JPO parity
+        JPE parity
+parity: JMP loop
+)">());
+
+// PUSH/POP of every pair, CALL, conditional CALL and RET
+const std::vector<uint8_t> stackLoop = bytes(assemble8080<R"(
+        LXI SP,8000H
+loop:   PUSH B
+        PUSH D
+        PUSH H
+        PUSH PSW
+        POP PSW
+        POP H
+        POP D
+        POP B
+        CALL call
+        XTHL
+        JMP loop
+        NOP
+call:   CNZ return
+        RET
+return: RET
+)">());
+
+// Loads and stores through every addressing mode
+const std::vector<uint8_t> memoryLoop = bytes(assemble8080<R"(
+        LXI H,2000H
+        LXI B,3000H
+loop:   MOV A,M
+        MOV M,A
+        INR M
+        DCR M
+        INX H
+        STAX B
+        LDAX B
+        INX B
+        STA 4000H
+        LDA 4000H
+        SHLD 4002H
+        LHLD 4002H
+        MVI M,0AAH
+        ADD M
+        MVI H,20H
+        MVI B,30H
+        JMP loop
+)">());
+
+// A stand-in for the Space Invaders ROM, run on the headless cabinet: RST 1
+// and RST 2 handlers that save registers and bump a counter, and a main loop
+// that XORs a 7 KiB image into VRAM at 0x2400.
+const std::vector<uint8_t> invadersFrame = [] {
+    std::vector<uint8_t> program(0x60, 0x00);
+    auto place = [&program](uint16_t address, const auto &bytes) {
+        std::copy(bytes.begin(), bytes.end(), program.begin() + address);
+    };
+    place(0x0000, assemble8080<"JMP 0040H">());
+    place(0x0008, assemble8080<R"(
+        PUSH PSW
+        PUSH B
+        PUSH D
+        PUSH H
+        JMP 0018H
+    )">());
+    place(0x0010, assemble8080<R"(
+        PUSH PSW
+        PUSH B
+        PUSH D
+        PUSH H
+        JMP 0028H
+    )">());
+    place(0x0018, assemble8080<R"(
+        LXI H,20C0H
+        INR M
+        POP H
+        POP D
+        POP B
+        POP PSW
+        EI
+        RET
+    )">());
+    place(0x0028, assemble8080<R"(
+        LXI H,20C1H
+        INR M
+        POP H
+        POP D
+        POP B
+        POP PSW
+        EI
+        RET
+    )">());
+    place(0x0040, assemble8080<R"(
+        LXI SP,2400H
+        EI
+frame:  LXI H,2400H
+        LXI B,1C00H
+        LXI D,0000H
+xor:    LDAX D
+        XRA M
+        MOV M,A
+        INX H
+        INX D
+        DCX B
+        MOV A,B
+        ORA C
+        JNZ xor
+        JMP frame
+    )", 0x0040>());
+    return program;
+}();
+
+struct Sample {
+    double seconds;
+    uint64_t cycles;
+    uint64_t instructions;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<Sample()> run;
+};
+
+template <typename F> Sample timed(Intel8080 &cpu, F &&body) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t cycles = body();
+    auto end = std::chrono::steady_clock::now();
+    return {std::chrono::duration<double>(end - start).count(), cycles,
+            cpu.instructions};
+}
+
+Benchmark micro(std::string name, const std::vector<uint8_t> &program,
+                size_t budget) {
+    return {"micro/" + name, [&program, budget] {
+                auto cpu = std::make_unique<Intel8080>();
+                cpu->memory.fill(0);
+                std::copy(program.begin(), program.end(), cpu->memory.begin());
+                return timed(*cpu,
+                             [&] { return cpu->execute(budget).cycles; });
+            }};
+}
+
+Benchmark com(const std::filesystem::path &path) {
+    auto image = std::make_shared<MappedFile>(path);
+    return {"com/" + path.stem().string(), [image] {
+                auto cpm = std::make_unique<CPM>();
+                cpm->console.setMode(Console::Mode::Capture);
+                cpm->load(image->data(), image->size());
+                return timed(*cpm, [&] { return cpm->execute().cycles; });
+            }};
+}
+
+// The same program counting accesses per page, as `runtests -a` does
+Benchmark comAccesses(const std::filesystem::path &path) {
+    auto image = std::make_shared<MappedFile>(path);
+    return {"accesses/" + path.stem().string(), [image] {
+                auto cpm = std::make_unique<CPM>();
+                cpm->console.setMode(Console::Mode::Capture);
+                cpm->load(image->data(), image->size());
+                auto map = std::make_unique<AccessMap>();
+                return timed(*cpm,
+                             [&] { return cpm->execute(0, *map).cycles; });
+            }};
+}
+
+Benchmark invaders(size_t frames) {
+    return {"program/invaders-frame", [frames] {
+                auto machine = std::make_unique<SpaceInvaders>();
+                std::copy(invadersFrame.begin(), invadersFrame.end(),
+                          machine->memory.begin());
+                return timed(*machine, [&] {
+                    uint64_t cycles = 0;
+                    for (size_t f = 0; f < frames; f++) {
+                        cycles += machine->frame().cycles;
+                    }
+                    return cycles;
+                });
+            }};
+}
+
+// The same program counting accesses per page
+Benchmark invadersAccesses(size_t frames) {
+    return {"accesses/invaders-frame", [frames] {
+                auto machine = std::make_unique<SpaceInvaders>();
+                std::copy(invadersFrame.begin(), invadersFrame.end(),
+                          machine->memory.begin());
+                auto map = std::make_unique<AccessMap>();
+                return timed(*machine, [&] {
+                    uint64_t cycles = 0;
+                    for (size_t f = 0; f < frames; f++) {
+                        cycles += machine->frame(*map).cycles;
+                    }
+                    return cycles;
+                });
+            }};
+}
+
+// The same program with every frame recorded, as `invaders -c` does
+Benchmark capture(size_t frames, const std::filesystem::path &path) {
+    return {"program/invaders-capture", [frames, path] {
+                auto machine = std::make_unique<SpaceInvaders>();
+                std::copy(invadersFrame.begin(), invadersFrame.end(),
+                          machine->memory.begin());
+                Capture capture(path, Capture::formatFor(path));
+                auto sample = timed(*machine, [&] {
+                    uint64_t cycles = 0;
+                    for (size_t f = 0; f < frames; f++) {
+                        cycles += machine->frame().cycles;
+                        capture.add(machine->vram());
+                    }
+                    capture.close();
+                    return cycles;
+                });
+                std::filesystem::remove(path);
+                return sample;
+            }};
+}
+
+// The same program on a batch of machines stepped in parallel
+Benchmark batch(size_t machines, size_t frames) {
+    return {"program/invaders-batch", [machines, frames] {
+                InvadersBatch batch(machines, invadersFrame.data(),
+                                    invadersFrame.size());
+                std::vector<uint8_t> actions(machines, 0);
+                auto start = std::chrono::steady_clock::now();
+                for (size_t f = 0; f < frames; f++) {
+                    batch.step(actions.data());
+                }
+                auto end = std::chrono::steady_clock::now();
+                Sample sample{
+                    std::chrono::duration<double>(end - start).count(), 0, 0};
+                for (size_t i = 0; i < machines; i++) {
+                    sample.cycles += batch.machine(i).now;
+                    sample.instructions += batch.machine(i).instructions;
+                }
+                return sample;
+            }};
+}
+
+double percentile(std::vector<double> sorted, double p) {
+    size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name
+              << " [-t TRIALS] [-w WARMUP] [--json] [--com FILE]..."
+              << " [--capture FILE] [FILTER]" << std::endl;
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    int trials = 7;
+    int warmup = 1;
+    bool json = false;
+    std::string filter;
+    std::vector<std::filesystem::path> coms;
+    auto capture_path =
+        std::filesystem::temp_directory_path() / "bench-capture.y4m";
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            trials = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (std::strcmp(argv[i], "--com") == 0 && i + 1 < argc) {
+            coms.push_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (argv[i][0] == '-') {
+            return usage(argv[0]);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    constexpr size_t budget = 20000000;
+    std::vector<Benchmark> benchmarks = {
+        micro("mov", movLoop, budget),
+        micro("alu", aluLoop, budget),
+        micro("branch", branchLoop, budget),
+        micro("stack", stackLoop, budget),
+        micro("memory", memoryLoop, budget),
+        invaders(600),
+        capture(600, capture_path),
+        batch(32, 60),
+        invadersAccesses(600),
+    };
+    try {
+        for (const auto &path : coms) {
+            benchmarks.push_back(com(path));
+        }
+        for (const auto &path : coms) {
+            benchmarks.push_back(comAccesses(path));
+        }
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!json) {
+        std::cout << std::left << std::setw(24) << "benchmark" << std::right
+                  << std::setw(10) << "MHz" << std::setw(10) << "p10"
+                  << std::setw(10) << "p90" << std::setw(10) << "MIPS"
+                  << std::endl;
+    }
+    for (const auto &benchmark : benchmarks) {
+        if (benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        for (int i = 0; i < warmup; i++) {
+            benchmark.run();
+        }
+        std::vector<double> mhz, mips;
+        for (int i = 0; i < trials; i++) {
+            auto sample = benchmark.run();
+            mhz.push_back(sample.cycles / sample.seconds / 1e6);
+            mips.push_back(sample.instructions / sample.seconds / 1e6);
+        }
+        std::sort(mhz.begin(), mhz.end());
+        std::sort(mips.begin(), mips.end());
+
+        std::cout << std::fixed << std::setprecision(1);
+        if (json) {
+            std::cout << "{\"benchmark\":\"" << benchmark.name
+                      << "\",\"trials\":" << trials
+                      << ",\"median_mhz\":" << percentile(mhz, 0.5)
+                      << ",\"p10_mhz\":" << percentile(mhz, 0.1)
+                      << ",\"p90_mhz\":" << percentile(mhz, 0.9)
+                      << ",\"min_mhz\":" << mhz.front()
+                      << ",\"max_mhz\":" << mhz.back()
+                      << ",\"median_mips\":" << percentile(mips, 0.5) << "}"
+                      << std::endl;
+        } else {
+            std::cout << std::left << std::setw(24) << benchmark.name
+                      << std::right << std::setw(10) << percentile(mhz, 0.5)
+                      << std::setw(10) << percentile(mhz, 0.1) << std::setw(10)
+                      << percentile(mhz, 0.9) << std::setw(10)
+                      << percentile(mips, 0.5) << std::endl;
+        }
+    }
+    return 0;
+}
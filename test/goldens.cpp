@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "access_map.h"
+#include "loader.h"
+#include "space_invaders.h"
+
+// Golden-frame regression suite for the Space Invaders machine. Each script
+// holds the player 1 inputs from a given frame on and lists the frames to
+// check:
+//
+//   # comment
+//   60 coin          hold the coin switch from frame 60
+//   66 -             release everything
+//   200 left fire
+//   check 100 300 600
+//
+// The hash of VRAM after each checked frame is compared against the
+// script's .golden file, which holds `FRAME HASH` lines. Frame 0 is the
+// screen before the first frame runs.
+
+enum Button : uint8_t {
+    Left = 1,
+    Right = 2,
+    Fire = 4,
+    Coin = 8,
+    Start = 16,
+};
+
+struct Script {
+    std::filesystem::path path;
+    std::filesystem::path golden;
+    std::vector<std::pair<uint64_t, uint8_t>> inputs;
+    std::vector<uint64_t> checks;
+    std::vector<std::pair<uint64_t, uint64_t>> hashes;
+    std::string failure;
+    std::string accesses;
+    double seconds = 0;
+};
+
+struct Options {
+    bool update = false;
+    bool accesses = false;
+    std::filesystem::path heatmap_dir;
+};
+
+void parse(Script &script) {
+    std::ifstream is(script.path);
+    if (!is) {
+        throw std::runtime_error("could not open '" + script.path.string() +
+                                 "'");
+    }
+    std::string line;
+    for (int number = 1; std::getline(is, line); number++) {
+        std::istringstream fields(line);
+        std::string first, word;
+        if (!(fields >> first) || first[0] == '#') {
+            continue;
+        }
+        auto error = [&] {
+            return std::runtime_error(script.path.string() + ":" +
+                                      std::to_string(number) + ": bad line");
+        };
+        if (first == "check") {
+            uint64_t frame;
+            while (fields >> frame) {
+                script.checks.push_back(frame);
+            }
+            if (!fields.eof()) {
+                throw error();
+            }
+            continue;
+        }
+        uint8_t buttons = 0;
+        while (fields >> word) {
+            if (word == "left") {
+                buttons |= Left;
+            } else if (word == "right") {
+                buttons |= Right;
+            } else if (word == "fire") {
+                buttons |= Fire;
+            } else if (word == "coin") {
+                buttons |= Coin;
+            } else if (word == "start") {
+                buttons |= Start;
+            } else if (word != "-") {
+                throw error();
+            }
+        }
+        try {
+            script.inputs.emplace_back(std::stoull(first), buttons);
+        } catch (std::logic_error &) {
+            throw error();
+        }
+    }
+    std::sort(script.checks.begin(), script.checks.end());
+    std::stable_sort(
+        script.inputs.begin(), script.inputs.end(),
+        [](const auto &a, const auto &b) { return a.first < b.first; });
+}
+
+void run(Script &script, const std::array<uint8_t, 0x10000> &image,
+         const Options &options) {
+    auto start = std::chrono::steady_clock::now();
+    auto machine = std::make_unique<SpaceInvaders>();
+    std::unique_ptr<AccessMap> map;
+    if (options.accesses || !options.heatmap_dir.empty()) {
+        map = std::make_unique<AccessMap>(!options.heatmap_dir.empty());
+    }
+    std::copy_n(image.begin(), SpaceInvaders::VRAM, machine->memory.begin());
+    auto input = script.inputs.begin();
+    auto check = script.checks.begin();
+    // `check 0` is the screen before the first frame runs
+    for (; check != script.checks.end() && *check == 0; ++check) {
+        script.hashes.emplace_back(0, machine->vramHash());
+    }
+    for (uint64_t frame = 0; check != script.checks.end(); frame++) {
+        for (; input != script.inputs.end() && input->first <= frame;
+             ++input) {
+            auto &port1 = machine->input.port1;
+            port1.left1 = (input->second & Left) != 0;
+            port1.right1 = (input->second & Right) != 0;
+            port1.shot1 = (input->second & Fire) != 0;
+            port1.credit = (input->second & Coin) != 0;
+            port1.start1 = (input->second & Start) != 0;
+        }
+        auto stop = map ? machine->frame(*map) : machine->frame();
+        if (stop.reason != StopReason::CycleLimit) {
+            std::ostringstream os;
+            os << toString(stop.reason) << " at " << std::hex
+               << std::setfill('0') << std::setw(4) << stop.PC
+               << " in frame " << std::dec << frame;
+            script.failure = os.str();
+            return;
+        }
+        for (; check != script.checks.end() && *check == frame + 1; ++check) {
+            script.hashes.emplace_back(*check, machine->vramHash());
+        }
+    }
+    script.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (options.accesses) {
+        std::ostringstream os;
+        map->report(os);
+        script.accesses = os.str();
+    }
+    if (!options.heatmap_dir.empty()) {
+        try {
+            map->writeHeatmap(options.heatmap_dir /
+                              script.path.stem().concat(".csv"));
+        } catch (std::runtime_error &e) {
+            script.failure = e.what();
+            return;
+        }
+    }
+
+    if (options.update) {
+        std::ofstream os(script.golden);
+        os << std::hex << std::setfill('0');
+        for (const auto &[frame, hash] : script.hashes) {
+            os << std::dec << frame << " " << std::hex << std::setw(16)
+               << hash << "\n";
+        }
+        if (!os) {
+            script.failure = "could not write '" + script.golden.string() + "'";
+        }
+        return;
+    }
+
+    std::ifstream is(script.golden);
+    if (!is) {
+        script.failure = "no golden hashes '" + script.golden.string() + "'";
+        return;
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> golden;
+    uint64_t frame, hash;
+    while (is >> std::dec >> frame >> std::hex >> hash) {
+        golden.emplace_back(frame, hash);
+    }
+    for (const auto &[frame, hash] : script.hashes) {
+        auto it = std::find_if(golden.begin(), golden.end(),
+                               [&](const auto &g) { return g.first == frame; });
+        if (it == golden.end()) {
+            script.failure =
+                "no golden hash for frame " + std::to_string(frame);
+            return;
+        }
+        if (it->second != hash) {
+            script.failure = "frame " + std::to_string(frame) + " differs";
+            return;
+        }
+    }
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name << " [-j THREADS] [-r ROM_DIR] [-s SET] [-u]"
+              << " [-a] [-H DIR] SCRIPT..." << std::endl
+              << "  -j THREADS  number of scripts to run at once" << std::endl
+              << "  -r ROM_DIR  directory with the ROMs and MANIFEST "
+                 "(default roms)"
+              << std::endl
+              << "  -s SET      ROM set to load (default invaders)" << std::endl
+              << "  -u          write golden hashes instead of checking them"
+              << std::endl
+              << "  -a          count memory accesses and print the busiest "
+                 "pages and any"
+              << std::endl
+              << "              writes to code that had already run"
+              << std::endl
+              << "  -H DIR      write a per-byte access heatmap of each script "
+                 "to DIR/<name>.csv"
+              << std::endl;
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::filesystem::path roms = "roms";
+    std::string set = "invaders";
+    Options options;
+    std::vector<Script> scripts;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            roms = argv[++i];
+        } else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            set = argv[++i];
+        } else if (std::strcmp(argv[i], "-u") == 0) {
+            options.update = true;
+        } else if (std::strcmp(argv[i], "-a") == 0) {
+            options.accesses = true;
+        } else if (std::strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            options.heatmap_dir = argv[++i];
+        } else if (argv[i][0] == '-') {
+            return usage(argv[0]);
+        } else {
+            scripts.emplace_back().path = argv[i];
+        }
+    }
+    if (scripts.empty()) {
+        return usage(argv[0]);
+    }
+
+    auto image = std::make_unique<std::array<uint8_t, 0x10000>>();
+    try {
+        Manifest manifest(roms / "MANIFEST");
+        loadSet(manifest, set, roms, *image);
+        for (auto &script : scripts) {
+            script.golden = std::filesystem::path(script.path)
+                                .replace_extension(".golden");
+            parse(script);
+        }
+    } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers;
+    threads = std::min<size_t>(threads, scripts.size());
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (size_t i = next++; i < scripts.size(); i = next++) {
+                run(scripts[i], *image, options);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    size_t failed = 0;
+    std::cout << std::fixed;
+    for (const auto &script : scripts) {
+        std::cout << (script.failure.empty() ? "PASS " : "FAIL ") << std::left
+                  << std::setw(20) << script.path.stem().string() << std::right
+                  << std::setprecision(3) << std::setw(9) << script.seconds
+                  << "s";
+        if (!script.failure.empty()) {
+            failed++;
+            std::cout << "  " << script.failure;
+        }
+        std::cout << std::endl;
+    }
+    for (const auto &script : scripts) {
+        if (!script.accesses.empty()) {
+            std::cout << std::endl
+                      << "Memory accesses of " << script.path.stem().string()
+                      << std::endl
+                      << script.accesses;
+        }
+    }
+    std::cout << scripts.size() - failed << "/" << scripts.size()
+              << " passed in " << std::setprecision(3) << elapsed << "s on "
+              << threads << " threads" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
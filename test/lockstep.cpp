@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpm.h"
+#include "disassembler.h"
+#include "emulator.h"
+#include "mapped_file.h"
+
+// Runs two execution engines side by side on the same machine state and
+// compares them after every block of cycles. When a block disagrees it is
+// replayed an instruction at a time to find the first differing instruction,
+// and the state before that instruction is shrunk to a minimal reproducer.
+
+struct Engine {
+    const char *name;
+    size_t (*run)(Intel8080 &cpu, size_t cycle_limit);
+};
+
+const Engine engines[] = {
+    {"reference",
+     [](Intel8080 &cpu, size_t cycle_limit) {
+         return cpu.execute(cycle_limit).cycles;
+     }},
+    {"monitored",
+     [](Intel8080 &cpu, size_t cycle_limit) {
+         NoMonitor monitor;
+         return cpu.execute(cycle_limit, monitor).cycles;
+     }},
+};
+
+// Not selectable with -e: the reference with DAA's carry inverted, so -t
+// can check that a divergence is found, located and minimised.
+const Engine broken = {
+    "broken-daa", [](Intel8080 &cpu, size_t cycle_limit) {
+        size_t cycles = 0;
+        while (cycles < cycle_limit && !cpu.halted) {
+            bool daa = cpu.memory[cpu.PC] == 0x27;
+            auto stop = cpu.execute(1);
+            cycles += stop.cycles;
+            if (daa) {
+                cpu.FLAGS.C = !cpu.FLAGS.C;
+            }
+            if (stop.reason != StopReason::CycleLimit) {
+                break;
+            }
+        }
+        return cycles;
+    }};
+
+const Engine *findEngine(const std::string &name) {
+    for (const auto &engine : engines) {
+        if (name == engine.name) {
+            return &engine;
+        }
+    }
+    return nullptr;
+}
+
+std::string describe(const Intel8080 &cpu) {
+    std::ostringstream os;
+    os << std::hex << std::setfill('0') << "PC=" << std::setw(4) << cpu.PC
+       << " SP=" << std::setw(4) << cpu.SP << " PSW=" << std::setw(4)
+       << cpu.PSW << " BC=" << std::setw(4) << cpu.BC << " DE=" << std::setw(4)
+       << cpu.DE << " HL=" << std::setw(4) << cpu.HL
+       << " halted=" << cpu.halted << " interrupts=" << cpu.interrupts;
+    return os.str();
+}
+
+bool registersDiffer(const Intel8080 &a, const Intel8080 &b) {
+    return a.PC != b.PC || a.SP != b.SP || a.PSW != b.PSW || a.BC != b.BC ||
+           a.DE != b.DE || a.HL != b.HL || a.halted != b.halted ||
+           a.interrupts != b.interrupts;
+}
+
+// Empty if both machines are in the same state, otherwise the first
+// difference found.
+std::string difference(const Intel8080 &a, const Intel8080 &b) {
+    if (registersDiffer(a, b)) {
+        return "registers differ";
+    }
+    if (a.instructions != b.instructions) {
+        return "instruction counts differ";
+    }
+    auto diff = std::mismatch(a.memory.begin(), a.memory.end(),
+                              b.memory.begin());
+    if (diff.first != a.memory.end()) {
+        std::ostringstream os;
+        os << std::hex << std::setfill('0') << "memory at " << std::setw(4)
+           << diff.first - a.memory.begin() << " differs: " << std::setw(2)
+           << (int)*diff.first << " vs " << std::setw(2) << (int)*diff.second;
+        return os.str();
+    }
+    return "";
+}
+
+class Checker {
+  public:
+    Checker(const Engine &a, const Engine &b) : a(a), b(b) {}
+
+    // Runs both machines for `cycles` cycles, comparing registers after
+    // every instruction and memory every `block` cycles. With `whole_blocks`
+    // the engines run a block at a time and registers are only compared at
+    // block boundaries. Returns false and fills in the report on the first
+    // divergence.
+    bool run(Intel8080 &x, Intel8080 &y, uint64_t cycles, size_t block,
+             bool whole_blocks) {
+        auto before = std::make_unique<Intel8080>();
+        for (uint64_t done = 0; done < cycles && !x.halted;) {
+            *before = x;
+            bool ok = true;
+            if (whole_blocks) {
+                size_t cx = a.run(x, block);
+                ok = cx == b.run(y, block) && !registersDiffer(x, y);
+                done += cx;
+            } else {
+                for (size_t cycle = 0; ok && cycle < block && !x.halted;) {
+                    size_t cx = step(a, x);
+                    ok = cx == step(b, y) && !registersDiffer(x, y);
+                    cycle += cx;
+                    done += cx;
+                }
+            }
+            if (!ok || !difference(x, y).empty()) {
+                x = *before;
+                y = *before;
+                locate(x, y);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string report;
+    // The minimised state before the diverging instruction, if found
+    std::unique_ptr<Intel8080> reproduced;
+
+  private:
+    const Engine &a;
+    const Engine &b;
+
+    size_t step(const Engine &engine, Intel8080 &cpu) {
+        return engine.run(cpu, 1);
+    }
+
+    // Devices are detached, the reproducer only covers the CPU.
+    bool diverges(const Intel8080 &state) {
+        auto x = std::make_unique<Intel8080>(state);
+        x->in_callback = nullptr;
+        x->out_callback = nullptr;
+        auto y = std::make_unique<Intel8080>(*x);
+        return step(a, *x) != step(b, *y) || !difference(*x, *y).empty();
+    }
+
+    void locate(Intel8080 &x, Intel8080 &y) {
+        auto before = std::make_unique<Intel8080>();
+        while (true) {
+            *before = x;
+            size_t cx = step(a, x);
+            size_t cy = step(b, y);
+            auto diff = difference(x, y);
+            if (cx != cy || !diff.empty()) {
+                std::ostringstream os;
+                os << "Divergence after " << before->instructions
+                   << " instructions, at "
+                   << disassemble(decode(before->memory, before->PC))
+                   << std::endl;
+                os << "  " << a.name << ": " << describe(x) << " (" << cx
+                   << " cycles)" << std::endl;
+                os << "  " << b.name << ": " << describe(y) << " (" << cy
+                   << " cycles)" << std::endl;
+                if (!diff.empty()) {
+                    os << "  " << diff << std::endl;
+                }
+                minimise(*before);
+                os << reproducer(*before);
+                report = os.str();
+                reproduced = std::move(before);
+                return;
+            }
+            if (x.halted) {
+                report = "Block diverged but no single instruction did";
+                return;
+            }
+        }
+    }
+
+    // Clears as much of the pre-divergence state as possible while keeping
+    // the divergence: memory in shrinking chunks, then each register.
+    void minimise(Intel8080 &state) {
+        auto candidate = std::make_unique<Intel8080>();
+        for (size_t chunk = state.memory.size() / 2; chunk > 0; chunk /= 2) {
+            for (size_t addr = 0; addr < state.memory.size(); addr += chunk) {
+                auto first = state.memory.begin() + addr;
+                if (std::all_of(first, first + chunk,
+                                [](uint8_t v) { return v == 0; })) {
+                    continue;
+                }
+                *candidate = state;
+                std::fill_n(candidate->memory.begin() + addr, chunk, 0);
+                if (diverges(*candidate)) {
+                    state = *candidate;
+                }
+            }
+        }
+        for (auto reg : {&Intel8080::SP, &Intel8080::BC, &Intel8080::DE,
+                         &Intel8080::HL}) {
+            *candidate = state;
+            (*candidate).*reg = 0;
+            if (diverges(*candidate)) {
+                state = *candidate;
+            }
+        }
+    }
+
+    std::string reproducer(const Intel8080 &state) {
+        std::ostringstream os;
+        os << "Minimised reproducer, state before the instruction:"
+           << std::endl
+           << "  " << describe(state) << std::endl
+           << "  memory (all other bytes zero):";
+        os << std::hex << std::setfill('0');
+        for (size_t addr = 0; addr < state.memory.size(); addr++) {
+            if (state.memory[addr] != 0) {
+                os << " " << std::setw(4) << addr << ":" << std::setw(2)
+                   << (int)state.memory[addr];
+            }
+        }
+        os << std::endl << "  context:";
+        for (int offset = -4; offset < 4; offset++) {
+            uint16_t addr = state.PC + offset;
+            os << (offset == 0 ? " [" : " ") << std::setw(2)
+               << (int)state.memory[addr] << (offset == 0 ? "]" : "");
+        }
+        os << std::endl;
+        return os.str();
+    }
+};
+
+void randomise(Intel8080 &cpu, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    cpu.reset();
+    for (size_t i = 0; i < cpu.memory.size(); i += 8) {
+        uint64_t bytes = rng();
+        std::memcpy(&cpu.memory[i], &bytes, 8);
+    }
+    // HLT would end most streams within a few hundred instructions
+    std::replace(cpu.memory.begin(), cpu.memory.end(), 0x76, 0x00);
+    uint64_t regs = rng();
+    cpu.PC = regs;
+    cpu.SP = regs >> 16;
+    cpu.BC = regs >> 32;
+    cpu.DE = regs >> 48;
+    regs = rng();
+    cpu.HL = regs;
+    cpu.PSW = ((regs >> 16) & 0xffd5) | 0x0002;
+    cpu.interrupts = (regs >> 32) & 1;
+}
+
+// Checks the broken engine against the reference on one random stream: it
+// must diverge at a DAA, minimised down to the opcode alone.
+int selfTest(uint64_t seed, size_t block) {
+    auto x = std::make_unique<Intel8080>();
+    auto y = std::make_unique<Intel8080>();
+    randomise(*x, seed);
+    *y = *x;
+    Checker checker(engines[0], broken);
+    bool found = !checker.run(*x, *y, 1000000, block, false);
+    std::cout << checker.report;
+    const auto &state = checker.reproduced;
+    bool minimal =
+        state != nullptr && state->memory[state->PC] == 0x27 &&
+        std::count_if(state->memory.begin(), state->memory.end(),
+                      [](uint8_t v) { return v != 0; }) == 1 &&
+        state->SP == 0 && state->BC == 0 && state->DE == 0 && state->HL == 0;
+    bool named = checker.report.find("DAA") != std::string::npos;
+    std::cout << "self-test: divergence " << (found ? "found" : "missed")
+              << ", " << (minimal ? "minimised" : "not minimised") << ", "
+              << (named ? "named" : "not named")
+              << (found && minimal && named ? ": OK" : ": FAILED")
+              << std::endl;
+    return found && minimal && named ? 0 : 1;
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name
+              << " [-e ENGINE] [-j THREADS] [-c CYCLES] [-b BLOCK] [-w]"
+                 " [-s SEED] [-t] [COM]"
+              << std::endl
+              << "  -e ENGINE   engine to check against the reference "
+                 "(default monitored)"
+              << std::endl
+              << "  -c CYCLES   cycles to check (default 1e9)" << std::endl
+              << "  -b BLOCK    cycles between memory comparisons "
+                 "(default 10000)"
+              << std::endl
+              << "  -w          run engines a whole block at a time and only "
+                 "compare registers between blocks"
+              << std::endl
+              << "  -s SEED     first random seed" << std::endl
+              << "  -t          check that a deliberately broken engine is "
+                 "caught and minimised"
+              << std::endl
+              << "Without a COM, random instruction streams are checked."
+              << std::endl
+              << "Engines:";
+    for (const auto &engine : engines) {
+        std::cerr << " " << engine.name;
+    }
+    std::cerr << std::endl;
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    const Engine *other = findEngine("monitored");
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t cycles = 1000000000;
+    size_t block = 10000;
+    bool whole_blocks = false;
+    uint64_t seed = 1;
+    const char *com = nullptr;
+    bool self_test = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            other = findEngine(argv[++i]);
+            if (other == nullptr) {
+                return usage(argv[0]);
+            }
+        } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cycles = std::stod(argv[++i]);
+        } else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            block = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-w") == 0) {
+            whole_blocks = true;
+        } else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (std::strcmp(argv[i], "-t") == 0) {
+            self_test = true;
+        } else if (argv[i][0] == '-' || com != nullptr) {
+            return usage(argv[0]);
+        } else {
+            com = argv[i];
+        }
+    }
+    if (self_test) {
+        return selfTest(seed, block);
+    }
+    const Engine &reference = engines[0];
+    auto start = std::chrono::steady_clock::now();
+
+    if (com != nullptr) {
+        auto x = std::make_unique<CPM>();
+        auto y = std::make_unique<CPM>();
+        try {
+            MappedFile image(com);
+            for (auto *cpm : {x.get(), y.get()}) {
+                cpm->console.setMode(Console::Mode::Capture);
+                cpm->load(image.data(), image.size());
+            }
+        } catch (std::runtime_error &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        Checker checker(reference, *other);
+        if (!checker.run(*x, *y, cycles, block, whole_blocks)) {
+            std::cout << checker.report;
+            return 1;
+        }
+        if (x->console.captured() != y->console.captured()) {
+            std::cout << "Console output differs" << std::endl;
+            return 1;
+        }
+        std::cout << x->instructions << " instructions match" << std::endl;
+        return 0;
+    }
+
+    // Random streams: each seed runs a fresh random machine for a slice of
+    // the budget, spread over the worker threads.
+    constexpr uint64_t SLICE = 1000000;
+    uint64_t seeds = (cycles + SLICE - 1) / SLICE;
+    std::atomic<uint64_t> next = 0;
+    std::atomic<uint64_t> checked = 0;
+    std::atomic<bool> failed = false;
+    std::mutex report_mutex;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            auto x = std::make_unique<Intel8080>();
+            auto y = std::make_unique<Intel8080>();
+            Checker checker(reference, *other);
+            for (uint64_t i = next++; i < seeds && !failed; i = next++) {
+                randomise(*x, seed + i);
+                *y = *x;
+                bool ok = checker.run(*x, *y, SLICE, block, whole_blocks);
+                checked += x->instructions;
+                if (!ok && !failed.exchange(true)) {
+                    std::lock_guard<std::mutex> lock(report_mutex);
+                    std::cout << "seed " << seed + i << ": " << checker.report;
+                }
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    std::cout << checked << " instructions checked in " << std::fixed
+              << std::setprecision(2) << elapsed << "s ("
+              << std::setprecision(1) << checked / elapsed / 1e6
+              << " M/s) on " << threads << " threads, " << reference.name
+              << " vs " << other->name << (failed ? ": FAILED" : ": OK")
+              << std::endl;
+    return failed ? 1 : 0;
+}
@@ -1,67 +1,322 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
-#include "emulator.h"
+#include "access_map.h"
+#include "cpm.h"
+#include "loader.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include "symbol_map.h"
+#include "trace.h"
 
-#include "BDOS.h"
+struct Test {
+    std::filesystem::path com;
+    std::filesystem::path expected;
+    const Manifest::Entry *manifest = nullptr;
+    std::string transcript;
+    std::string failure;
+    std::string profile;
+    std::string accesses;
+    double seconds = 0;
+    uint64_t instructions = 0;
+};
 
-#ifdef TST8080
-#include "TST8080.h"
-unsigned char *test_bin = coms_TST8080_COM;
-unsigned int test_len = coms_TST8080_COM_len;
-#endif
+struct Options {
+    bool update = false;
+    bool profile = false;
+    bool accesses = false;
+    std::filesystem::path heatmap_dir;
+    std::filesystem::path trace_dir;
+    size_t trace_ring = 0;
+    double timeout = 0;
+};
 
-#ifdef CPUTEST
-#include "CPUTEST.h"
-unsigned char *test_bin = coms_CPUTEST_COM;
-unsigned int test_len = coms_CPUTEST_COM_len;
-#endif
+// Asks `cpu` to stop if it is still running after `seconds`
+class Watchdog {
+  public:
+    Watchdog(Intel8080 &cpu, double seconds) {
+        if (seconds > 0) {
+            thread = std::thread([this, &cpu, seconds] {
+                std::unique_lock lock(mutex);
+                if (!cv.wait_for(lock, std::chrono::duration<double>(seconds),
+                                 [this] { return done; })) {
+                    cpu.requestStop();
+                }
+            });
+        }
+    }
 
-#ifdef _8080PRE
-#include "8080PRE.h"
-unsigned char *test_bin = coms_8080PRE_COM;
-unsigned int test_len = coms_8080PRE_COM_len;
-#endif
+    ~Watchdog() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard lock(mutex);
+                done = true;
+            }
+            cv.notify_one();
+            thread.join();
+        }
+    }
 
-#ifdef _8080EXM
-#include "8080EXM.h"
-unsigned char *test_bin = coms_8080EXM_COM;
-unsigned int test_len = coms_8080EXM_COM_len;
-#endif
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    std::thread thread;
+};
 
-uint8_t in_callback(uint8_t port) {
-    static uint8_t halt = 0;
-    if (port == 0) {
-        return halt++;
+// Names addresses if the COM was built with `bin/asm -m`
+std::optional<SymbolMap> symbolsFor(const std::filesystem::path &com) {
+    auto map = com;
+    map.replace_extension(".map");
+    if (!std::filesystem::exists(map)) {
+        return std::nullopt;
     }
-    return 0;
+    return SymbolMap::read(map);
 }
 
-void out_callback(uint8_t port, uint8_t A) {
-    if (port == 0) {
-        std::cout << A;
+void runTest(Test &test, const Options &options) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+        MappedFile com(test.com);
+        if (test.manifest != nullptr) {
+            verify(*test.manifest, com);
+        }
+        auto cpm = std::make_unique<CPM>();
+        cpm->console.setMode(Console::Mode::Capture);
+        cpm->load(com.data(), com.size());
+        Watchdog watchdog(*cpm, options.timeout);
+        Stop stop;
+        if (!options.trace_dir.empty()) {
+            auto path = options.trace_dir / test.com.stem().concat(".trace");
+            if (options.trace_ring == 0) {
+                Tracer tracer(path);
+                stop = cpm->execute(0, tracer);
+            } else {
+                Tracer tracer(options.trace_ring);
+                stop = cpm->execute(0, tracer);
+                tracer.save(path);
+            }
+        } else if (options.profile) {
+            auto profiler = std::make_unique<Profiler>();
+            stop = cpm->execute(0, *profiler);
+            auto symbols = symbolsFor(test.com);
+            std::ostringstream os;
+            profiler->report(os, 20, symbols ? &*symbols : nullptr);
+            test.profile = os.str();
+        } else if (options.accesses || !options.heatmap_dir.empty()) {
+            auto map =
+                std::make_unique<AccessMap>(!options.heatmap_dir.empty());
+            stop = cpm->execute(0, *map);
+            if (!options.heatmap_dir.empty()) {
+                map->writeHeatmap(options.heatmap_dir /
+                                  test.com.stem().concat(".csv"));
+            }
+            if (options.accesses) {
+                auto symbols = symbolsFor(test.com);
+                std::ostringstream os;
+                map->report(os, 20, symbols ? &*symbols : nullptr);
+                test.accesses = os.str();
+            }
+        } else {
+            stop = cpm->execute();
+        }
+        test.instructions = cpm->instructions;
+        test.transcript = cpm->console.captured();
+        if (stop.reason != StopReason::Halt) {
+            std::ostringstream os;
+            os << (stop.reason == StopReason::HostRequest
+                       ? "timed out"
+                       : toString(stop.reason))
+               << " at " << std::hex << std::setfill('0') << std::setw(4)
+               << stop.PC;
+            test.failure = os.str();
+            return;
+        }
+    } catch (std::runtime_error &e) {
+        test.failure = e.what();
+        return;
+    }
+    test.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    if (options.update) {
+        std::ofstream os(test.expected, std::ios::binary);
+        if (!os.write(test.transcript.data(), test.transcript.size())) {
+            test.failure = "could not write '" + test.expected.string() + "'";
+        }
+        return;
     }
+
+    std::ifstream is(test.expected, std::ios::binary);
+    if (!is) {
+        test.failure =
+            "no expected transcript '" + test.expected.string() + "'";
+        return;
+    }
+    std::ostringstream expected;
+    expected << is.rdbuf();
+    const auto &want = expected.str();
+    const auto &got = test.transcript;
+    if (want != got) {
+        size_t offset = std::mismatch(want.begin(), want.end(), got.begin(),
+                                      got.end())
+                            .first -
+                        want.begin();
+        test.failure = "transcript differs at byte " + std::to_string(offset);
+    }
+}
+
+int usage(const char *name) {
+    std::cerr << "usage: " << name << " [-j THREADS] [-e DIR] [-u] [-p]"
+              << " [-a] [-H DIR] [-t DIR [-r RECORDS]] [-T SECONDS] COM..."
+              << std::endl
+              << "  -j THREADS  number of tests to run at once" << std::endl
+              << "  -e DIR      directory of expected transcripts "
+                 "(default test/expected)"
+              << std::endl
+              << "  -u          write transcripts instead of checking them"
+              << std::endl
+              << "  -p          profile each test and print the reports, "
+                 "naming addresses"
+              << std::endl
+              << "              from NAME.map beside NAME.COM if there is one"
+              << std::endl
+              << "  -a          count memory accesses and print the busiest "
+                 "pages and any"
+              << std::endl
+              << "              writes to code that had already run"
+              << std::endl
+              << "  -H DIR      write a per-byte access heatmap of each test "
+                 "to DIR/<name>.csv"
+              << std::endl
+              << "  -t DIR      write a binary execution trace of each test to "
+                 "DIR/<name>.trace"
+              << std::endl
+              << "  -r RECORDS  only keep the last RECORDS records of each trace"
+              << std::endl
+              << "  -T SECONDS  fail tests that run for longer than SECONDS"
+              << std::endl;
+    return 2;
 }
 
-int main() {
-    Intel8080 i8080;
-    i8080.in_callback = in_callback;
-    i8080.out_callback = out_callback;
-    // Load mock CPM BDOS at address 0
-    for (uint16_t i = 0; i < bin_BDOS_len; i++) {
-        i8080.memory[i] = bin_BDOS[i];
+int main(int argc, char **argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::filesystem::path expected_dir = "test/expected";
+    Options options;
+    std::vector<Test> tests;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            expected_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "-u") == 0) {
+            options.update = true;
+        } else if (std::strcmp(argv[i], "-p") == 0) {
+            options.profile = true;
+        } else if (std::strcmp(argv[i], "-a") == 0) {
+            options.accesses = true;
+        } else if (std::strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            options.heatmap_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            options.trace_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            options.trace_ring = std::atoll(argv[++i]);
+        } else if (std::strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            options.timeout = std::atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            return usage(argv[0]);
+        } else {
+            tests.emplace_back().com = argv[i];
+        }
     }
-    // Load test com at address 0x100
-    for (uint16_t i = 0; i < test_len; i++) {
-        i8080.memory[i + 0x100] = test_bin[i];
+    if (tests.empty()) {
+        return usage(argv[0]);
     }
+    // COMs listed in a MANIFEST next to them are checked before they run
+    std::map<std::filesystem::path, std::unique_ptr<Manifest>> manifests;
     try {
-        i8080.execute();
-        std::cout << std::endl;
+        for (auto &test : tests) {
+            test.expected = expected_dir / test.com.stem().concat(".txt");
+            auto path = test.com.parent_path() / "MANIFEST";
+            auto &manifest = manifests[path];
+            if (manifest == nullptr && std::filesystem::exists(path)) {
+                manifest = std::make_unique<Manifest>(path);
+            }
+            if (manifest != nullptr) {
+                test.manifest = manifest->find(test.com.filename().string());
+            }
+        }
     } catch (std::runtime_error &e) {
-        std::cout << e.what() << std::endl;
+        std::cerr << e.what() << std::endl;
         return 1;
     }
-    return 0;
-}
\ No newline at end of file
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers;
+    threads = std::min<size_t>(threads, tests.size());
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (size_t i = next++; i < tests.size(); i = next++) {
+                runTest(tests[i], options);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    size_t failed = 0;
+    std::cout << std::fixed;
+    for (const auto &test : tests) {
+        double mips = test.seconds > 0 ? test.instructions / test.seconds / 1e6
+                                       : 0;
+        std::cout << (test.failure.empty() ? "PASS " : "FAIL ") << std::left
+                  << std::setw(12) << test.com.stem().string() << std::right
+                  << std::setprecision(3) << std::setw(9) << test.seconds
+                  << "s " << std::setprecision(1) << std::setw(8) << mips
+                  << " MIPS";
+        if (!test.failure.empty()) {
+            failed++;
+            std::cout << "  " << test.failure;
+        }
+        std::cout << std::endl;
+    }
+    for (const auto &test : tests) {
+        if (!test.profile.empty()) {
+            std::cout << std::endl
+                      << "Profile of " << test.com.stem().string() << std::endl
+                      << test.profile;
+        }
+        if (!test.accesses.empty()) {
+            std::cout << std::endl
+                      << "Memory accesses of " << test.com.stem().string()
+                      << std::endl
+                      << test.accesses;
+        }
+    }
+    std::cout << tests.size() - failed << "/" << tests.size() << " passed in "
+              << std::setprecision(3) << elapsed << "s on " << threads
+              << " threads" << std::endl;
+    return failed == 0 ? 0 : 1;
+}